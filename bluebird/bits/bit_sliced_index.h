@@ -0,0 +1,580 @@
+// Copyright 2023 The titan-search Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef BLUEBIRD_BITS_BIT_SLICED_INDEX_H_
+#define BLUEBIRD_BITS_BIT_SLICED_INDEX_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>  // for std::memcpy()
+#include <vector>
+
+#include "bluebird/bits/bitmap.h"
+
+namespace bluebird {
+
+    /**
+     * A bit-sliced index (BSI) associates an unsigned 64-bit integer value with
+     * each 32-bit column (row id). Bit i of every value is stored in slice i,
+     * which is an ordinary Bitmap, and an existence bitmap records which
+     * columns carry a value at all.
+     *
+     * Range predicates, sums and top-k selections are evaluated with whole
+     * bitmap operations (O'Neil & Quass, "Improved Query Performance with
+     * Variant Indexes"), so numeric filters run on the same compressed
+     * containers as term filters and combine with them through the optional
+     * 'foundSet' argument.
+     */
+    class BitSlicedIndex {
+    public:
+        /**
+         * Comparison operators accepted by compare().
+         */
+        enum class Operation {
+            LT, LE, GT, GE, EQ, NEQ
+        };
+
+        /**
+         * Create an empty index.
+         */
+        BitSlicedIndex() = default;
+
+        BitSlicedIndex(const BitSlicedIndex &r) = default;
+
+        BitSlicedIndex(BitSlicedIndex &&r) noexcept = default;
+
+        BitSlicedIndex &operator=(const BitSlicedIndex &r) = default;
+
+        BitSlicedIndex &operator=(BitSlicedIndex &&r) noexcept = default;
+
+        /**
+         * Set the value of 'column', replacing any previous value.
+         */
+        void setValue(uint32_t column, uint64_t value) {
+            ensureBitCount(bitWidth(value));
+            for (size_t i = 0; i < slices.size(); ++i) {
+                if ((value >> i) & 1) {
+                    slices[i].add(column);
+                } else {
+                    slices[i].remove(column);
+                }
+            }
+            ebm.add(column);
+        }
+
+        /**
+         * Set the values of 'n' columns at once. columns[k] receives values[k].
+         * The columns are expected to be distinct; they are applied slice by
+         * slice with bitmap operations rather than one column at a time.
+         */
+        void setValues(size_t n, const uint32_t *columns, const uint64_t *values) {
+            if (n == 0) {
+                return;
+            }
+            uint64_t all_bits = 0;
+            for (size_t k = 0; k < n; ++k) {
+                all_bits |= values[k];
+            }
+            ensureBitCount(bitWidth(all_bits));
+
+            Bitmap touched(n, columns);
+            std::vector<uint32_t> set_columns;
+            set_columns.reserve(n);
+            for (size_t i = 0; i < slices.size(); ++i) {
+                set_columns.clear();
+                for (size_t k = 0; k < n; ++k) {
+                    if ((values[k] >> i) & 1) {
+                        set_columns.push_back(columns[k]);
+                    }
+                }
+                slices[i] -= touched;
+                slices[i].addMany(set_columns.size(), set_columns.data());
+            }
+            ebm |= touched;
+        }
+
+        /**
+         * Fetch the value of 'column'. Returns false if the column has no value.
+         */
+        bool getValue(uint32_t column, uint64_t *value) const noexcept {
+            if (!ebm.contains(column)) {
+                return false;
+            }
+            uint64_t v = 0;
+            for (size_t i = 0; i < slices.size(); ++i) {
+                if (slices[i].contains(column)) {
+                    v |= uint64_t(1) << i;
+                }
+            }
+            *value = v;
+            return true;
+        }
+
+        /**
+         * Check whether 'column' has a value.
+         */
+        bool hasValue(uint32_t column) const noexcept { return ebm.contains(column); }
+
+        /**
+         * Remove the value of 'column', if any.
+         */
+        void remove(uint32_t column) noexcept {
+            if (!ebm.removeChecked(column)) {
+                return;
+            }
+            for (auto &slice: slices) {
+                slice.remove(column);
+            }
+        }
+
+        /**
+         * Remove every value.
+         */
+        void clear() noexcept {
+            ebm = Bitmap();
+            slices.clear();
+        }
+
+        /**
+         * Number of columns that have a value.
+         */
+        uint64_t cardinality() const noexcept { return ebm.cardinality(); }
+
+        /**
+         * Returns true if no column has a value.
+         */
+        bool isEmpty() const noexcept { return ebm.isEmpty(); }
+
+        /**
+         * Number of bit slices, i.e. the bit width of the largest value ever
+         * stored.
+         */
+        size_t bitCount() const noexcept { return slices.size(); }
+
+        /**
+         * The columns that have a value.
+         */
+        const Bitmap &existence() const noexcept { return ebm; }
+
+        /**
+         * The columns whose value has bit 'i' set. 'i' must be < bitCount().
+         */
+        const Bitmap &slice(size_t i) const noexcept { return slices[i]; }
+
+        /**
+         * Return the columns whose value satisfies "value <op> 'value'".
+         * If 'foundSet' is not NULL, only columns in 'foundSet' are considered.
+         */
+        Bitmap compare(Operation op, uint64_t value,
+                       const Bitmap *foundSet = nullptr) const {
+            const bool want_lt = op == Operation::LT || op == Operation::LE ||
+                                 op == Operation::NEQ;
+            const bool want_gt = op == Operation::GT || op == Operation::GE ||
+                                 op == Operation::NEQ;
+            Bitmap eq = foundSet == nullptr ? ebm : ebm & *foundSet;
+            Bitmap lt, gt;
+            if (bitWidth(value) > slices.size()) {
+                // 'value' is larger than anything the slices can represent.
+                lt.swap(eq);
+            } else {
+                for (size_t i = slices.size(); i-- > 0 && !eq.isEmpty();) {
+                    if ((value >> i) & 1) {
+                        if (want_lt) {
+                            lt |= eq - slices[i];
+                        }
+                        eq &= slices[i];
+                    } else {
+                        if (want_gt) {
+                            gt |= eq & slices[i];
+                        }
+                        eq -= slices[i];
+                    }
+                }
+            }
+            switch (op) {
+                case Operation::LT:
+                    return lt;
+                case Operation::LE:
+                    lt |= eq;
+                    return lt;
+                case Operation::GT:
+                    return gt;
+                case Operation::GE:
+                    gt |= eq;
+                    return gt;
+                case Operation::EQ:
+                    return eq;
+                case Operation::NEQ:
+                    lt |= gt;
+                    return lt;
+            }
+            return Bitmap();
+        }
+
+        /**
+         * Return the columns whose value lies in the closed interval [min, max].
+         * If 'foundSet' is not NULL, only columns in 'foundSet' are considered.
+         */
+        Bitmap between(uint64_t min, uint64_t max,
+                       const Bitmap *foundSet = nullptr) const {
+            if (min > max) {
+                return Bitmap();
+            }
+            Bitmap ge = compare(Operation::GE, min, foundSet);
+            return compare(Operation::LE, max, &ge);
+        }
+
+        /**
+         * Return the sum of the values of the columns in 'foundSet' (or of all
+         * columns if 'foundSet' is NULL), modulo 2^64. If 'count' is not NULL,
+         * it receives the number of columns that contributed to the sum.
+         */
+        uint64_t sum(const Bitmap *foundSet = nullptr,
+                     uint64_t *count = nullptr) const {
+            uint64_t result = 0;
+            if (foundSet == nullptr) {
+                for (size_t i = 0; i < slices.size(); ++i) {
+                    result += slices[i].cardinality() << i;
+                }
+                if (count != nullptr) {
+                    *count = ebm.cardinality();
+                }
+                return result;
+            }
+            Bitmap found = ebm & *foundSet;
+            for (size_t i = 0; i < slices.size(); ++i) {
+                result += slices[i].and_cardinality(found) << i;
+            }
+            if (count != nullptr) {
+                *count = found.cardinality();
+            }
+            return result;
+        }
+
+        /**
+         * Return the 'k' columns holding the largest values among 'foundSet' (or
+         * among all columns if 'foundSet' is NULL). Ties at the k-th value are
+         * broken in favor of the smallest column ids. If fewer than 'k' columns
+         * qualify, all of them are returned.
+         */
+        Bitmap topK(uint64_t k, const Bitmap *foundSet = nullptr) const {
+            Bitmap candidates = foundSet == nullptr ? ebm : ebm & *foundSet;
+            if (k >= candidates.cardinality()) {
+                return candidates;
+            }
+            Bitmap result;
+            if (k == 0) {
+                return result;
+            }
+            // 'result' holds columns known to be in the top k, 'candidates' the
+            // columns whose value matches the top k-th value on the bits seen
+            // so far. The two sets stay disjoint.
+            uint64_t result_card = 0;
+            for (size_t i = slices.size(); i-- > 0;) {
+                uint64_t n = result_card + candidates.and_cardinality(slices[i]);
+                if (n > k) {
+                    candidates &= slices[i];
+                } else if (n < k) {
+                    result |= candidates & slices[i];
+                    result_card = n;
+                    candidates -= slices[i];
+                } else {
+                    candidates &= slices[i];
+                    result |= candidates;
+                    return result;
+                }
+            }
+            // The remaining candidates all hold the same value; keep as many of
+            // the smallest column ids as needed.
+            uint32_t last;
+            if (!candidates.select(uint32_t(k - result_card - 1), &last)) {
+                ROARING_TERMINATE("Logic error: not enough top-k candidates");
+            }
+            candidates.removeRange(uint64_t(last) + 1, uint64_t(1) << 32);
+            result |= candidates;
+            return result;
+        }
+
+        /**
+         * Convert containers of every slice to run containers where this is
+         * more efficient. Returns true if any slice has a run container.
+         */
+        bool runOptimize() noexcept {
+            bool has_run = ebm.runOptimize();
+            for (auto &slice: slices) {
+                has_run = slice.runOptimize() || has_run;
+            }
+            return has_run;
+        }
+
+        /**
+         * If needed, reallocate memory to shrink the memory usage. Returns
+         * the number of bytes saved.
+         */
+        size_t shrinkToFit() noexcept {
+            size_t saved = ebm.shrinkToFit();
+            for (auto &slice: slices) {
+                saved += slice.shrinkToFit();
+            }
+            return saved;
+        }
+
+        /**
+         * Return true if the two indexes map the same columns to the same values.
+         */
+        bool operator==(const BitSlicedIndex &r) const noexcept {
+            if (!(ebm == r.ebm)) {
+                return false;
+            }
+            size_t common = std::min(slices.size(), r.slices.size());
+            for (size_t i = 0; i < common; ++i) {
+                if (!(slices[i] == r.slices[i])) {
+                    return false;
+                }
+            }
+            // Extra slices may exist on one side after values were overwritten
+            // with narrower ones; they must be empty.
+            for (size_t i = common; i < slices.size(); ++i) {
+                if (!slices[i].isEmpty()) return false;
+            }
+            for (size_t i = common; i < r.slices.size(); ++i) {
+                if (!r.slices[i].isEmpty()) return false;
+            }
+            return true;
+        }
+
+        /**
+         * Write the index to a char buffer: a cookie, the number of slices and
+         * then the portable serialization of the existence bitmap and of every
+         * slice. Returns how many bytes were written which should be
+         * getSizeInBytes().
+         */
+        size_t write(char *buf) const noexcept {
+            const char *orig = buf;
+            uint32_t header[2] = {BSI_SERIAL_COOKIE, uint32_t(slices.size())};
+            std::memcpy(buf, header, sizeof(header));
+            buf += sizeof(header);
+            buf += ebm.write(buf);
+            for (const auto &slice: slices) {
+                buf += slice.write(buf);
+            }
+            return buf - orig;
+        }
+
+        /**
+         * How many bytes are required to serialize this index with write().
+         */
+        size_t getSizeInBytes() const noexcept {
+            size_t size = 2 * sizeof(uint32_t) + ebm.getSizeInBytes();
+            for (const auto &slice: slices) {
+                size += slice.getSizeInBytes();
+            }
+            return size;
+        }
+
+        /**
+         * Read an index written by write().
+         *
+         * This function is unsafe in the sense that if you provide bad data,
+         * many bytes could be read. See also readSafe.
+         * The function may throw std::runtime_error.
+         */
+        static BitSlicedIndex read(const char *buf) {
+            uint32_t header[2];
+            std::memcpy(header, buf, sizeof(header));
+            if (header[0] != BSI_SERIAL_COOKIE) {
+                ROARING_TERMINATE("invalid bit-sliced index cookie");
+            }
+            buf += sizeof(header);
+            BitSlicedIndex result;
+            result.ebm = Bitmap::read(buf);
+            buf += result.ebm.getSizeInBytes();
+            result.slices.reserve(header[1]);
+            for (uint32_t i = 0; i < header[1]; ++i) {
+                result.slices.push_back(Bitmap::read(buf));
+                buf += result.slices.back().getSizeInBytes();
+            }
+            return result;
+        }
+
+        /**
+         * Read an index written by write(), reading no more than maxbytes bytes.
+         * The function may throw std::runtime_error.
+         */
+        static BitSlicedIndex readSafe(const char *buf, size_t maxbytes) {
+            uint32_t header[2];
+            if (maxbytes < sizeof(header)) {
+                ROARING_TERMINATE("ran out of bytes");
+            }
+            std::memcpy(header, buf, sizeof(header));
+            if (header[0] != BSI_SERIAL_COOKIE) {
+                ROARING_TERMINATE("invalid bit-sliced index cookie");
+            }
+            buf += sizeof(header);
+            maxbytes -= sizeof(header);
+            BitSlicedIndex result;
+            result.ebm = Bitmap::readSafe(buf, maxbytes);
+            size_t tz = result.ebm.getSizeInBytes();
+            buf += tz;
+            maxbytes -= tz;
+            for (uint32_t i = 0; i < header[1]; ++i) {
+                result.slices.push_back(Bitmap::readSafe(buf, maxbytes));
+                tz = result.slices.back().getSizeInBytes();
+                buf += tz;
+                maxbytes -= tz;
+            }
+            return result;
+        }
+
+        /**
+         * How many bytes are required by writeFrozen().
+         */
+        size_t getFrozenSizeInBytes() const noexcept {
+            size_t ret = 2 * sizeof(uint32_t);
+            ret = frozenEntrySize(ret, ebm);
+            for (const auto &slice: slices) {
+                ret = frozenEntrySize(ret, slice);
+            }
+            return ret;
+        }
+
+        /**
+         * Serialize the index in the frozen format so that frozenView() can
+         * query it in place, e.g. from a memory-mapped file. 'buf' must be
+         * aligned by 32 bytes and hold getFrozenSizeInBytes() bytes.
+         *
+         * Layout: a cookie and the number of slices, followed by the existence
+         * bitmap and every slice. Each bitmap is preceded by padding and its
+         * frozen length (uint64_t), the padding being chosen so that the frozen
+         * bitmap itself starts on a 32-byte boundary as required by
+         * Bitmap::frozenView.
+         */
+        void writeFrozen(char *buf) const noexcept {
+            const char *orig = buf;
+            uint32_t header[2] = {BSI_FROZEN_COOKIE, uint32_t(slices.size())};
+            std::memcpy(buf, header, sizeof(header));
+            buf += sizeof(header);
+            buf = writeFrozenEntry(orig, buf, ebm);
+            for (const auto &slice: slices) {
+                buf = writeFrozenEntry(orig, buf, slice);
+            }
+        }
+
+        /**
+         * Create a read-only index that is a view of a buffer written by
+         * writeFrozen(). The buffer must be aligned by 32 bytes and must outlive
+         * the returned index. No container data is copied.
+         * This function may throw std::runtime_error.
+         */
+        static const BitSlicedIndex frozenView(const char *buf, size_t length) {
+            const char *orig = buf;
+            uint32_t header[2];
+            if ((uintptr_t) buf % 32 != 0 || length < sizeof(header)) {
+                ROARING_TERMINATE("failed to read frozen bit-sliced index");
+            }
+            std::memcpy(header, buf, sizeof(header));
+            if (header[0] != BSI_FROZEN_COOKIE) {
+                ROARING_TERMINATE("invalid bit-sliced index cookie");
+            }
+            // every slice takes at least its length prefix
+            if (header[1] > (length - sizeof(header)) / sizeof(uint64_t)) {
+                ROARING_TERMINATE("failed to read frozen bit-sliced index");
+            }
+            buf += sizeof(header);
+            BitSlicedIndex result;
+            buf = viewFrozenEntry(orig, buf, length, result.ebm);
+            result.slices.resize(header[1]);
+            for (auto &slice: result.slices) {
+                buf = viewFrozenEntry(orig, buf, length, slice);
+            }
+            return result;
+        }
+
+    private:
+        enum : uint32_t {
+            BSI_SERIAL_COOKIE = 0x42534931,  // "BSI1"
+            BSI_FROZEN_COOKIE = 0x42534946   // "BSIF"
+        };
+
+        Bitmap ebm{};
+        std::vector<Bitmap> slices{};
+
+        static size_t bitWidth(uint64_t value) {
+            size_t width = 0;
+            while (value != 0) {
+                ++width;
+                value >>= 1;
+            }
+            return width;
+        }
+
+        void ensureBitCount(size_t count) {
+            while (slices.size() < count) {
+                slices.emplace_back();
+                slices.back().setCopyOnWrite(ebm.getCopyOnWrite());
+            }
+        }
+
+        // Frozen entries are (padding, uint64_t length, frozen bitmap) with the
+        // bitmap starting at a multiple of 32 from the start of the buffer.
+        static size_t frozenPadding(size_t offset) {
+            size_t start = offset + sizeof(uint64_t);
+            return (32 - start % 32) % 32;
+        }
+
+        static size_t frozenEntrySize(size_t offset, const Bitmap &bitmap) {
+            offset += frozenPadding(offset) + sizeof(uint64_t);
+            return offset + bitmap.getFrozenSizeInBytes();
+        }
+
+        static char *writeFrozenEntry(const char *orig, char *buf,
+                                      const Bitmap &bitmap) {
+            size_t padding = frozenPadding(size_t(buf - orig));
+            std::memset(buf, 0, padding);
+            buf += padding;
+            uint64_t len = bitmap.getFrozenSizeInBytes();
+            std::memcpy(buf, &len, sizeof(len));
+            buf += sizeof(len);
+            bitmap.writeFrozen(buf);
+            return buf + len;
+        }
+
+        static const char *viewFrozenEntry(const char *orig, const char *buf,
+                                           size_t length, Bitmap &out) {
+            size_t offset = size_t(buf - orig) + frozenPadding(size_t(buf - orig));
+            uint64_t len;
+            if (offset + sizeof(len) > length) {
+                ROARING_TERMINATE("ran out of bytes");
+            }
+            std::memcpy(&len, orig + offset, sizeof(len));
+            offset += sizeof(len);
+            if (len > length - offset) {
+                ROARING_TERMINATE("ran out of bytes");
+            }
+            const roaring::api::roaring_bitmap_t *s =
+                    roaring::api::roaring_bitmap_frozen_view(orig + offset, len);
+            if (s == NULL) {
+                ROARING_TERMINATE("failed to read frozen bitmap");
+            }
+            // Adopt the view in place: going through Bitmap::frozenView would
+            // hand back a const Bitmap, which can only be copied, not moved.
+            out.roaring = *s;
+            return orig + offset + len;
+        }
+    };
+
+}  // namespace bluebird
+
+#endif  // BLUEBIRD_BITS_BIT_SLICED_INDEX_H_
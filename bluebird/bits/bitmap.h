@@ -23,6 +23,7 @@
 #include <new>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 #if !defined(ROARING_EXCEPTIONS)
 // __cpp_exceptions is required by C++98 and we require C++11 or better.
@@ -232,6 +233,145 @@ namespace bluebird {
             return roaring::api::roaring_bitmap_contains_range(&roaring, x, y);
         }
 
+        /**
+         * Remembers the last container touched by addBulk() or containsBulk()
+         * so that consecutive values sharing their 16 most significant bits
+         * skip the container lookup.
+         *
+         * A context must only be used with the bitmap it was first used with,
+         * and becomes invalid as soon as that bitmap is modified by any other
+         * means than addBulk() with the same context.
+         */
+        class BulkContext {
+        public:
+            friend class Bitmap;
+
+            BulkContext() noexcept: context{nullptr, 0, 0, 0} {}
+
+            BulkContext(const BulkContext &) = delete;
+
+            BulkContext &operator=(const BulkContext &) = delete;
+
+            BulkContext(BulkContext &&) noexcept = default;
+
+            BulkContext &operator=(BulkContext &&) noexcept = default;
+
+            /**
+             * Forget the cached container, e.g. after the bitmap was modified.
+             */
+            void reset() noexcept { context = {nullptr, 0, 0, 0}; }
+
+        private:
+            roaring::api::roaring_bulk_context_t context;
+        };
+
+        /**
+         * Add value x, reusing the container cached in the context when
+         * possible. Faster than add() for runs of values that share their 16
+         * most significant bits.
+         */
+        void addBulk(BulkContext &context, uint32_t x) noexcept {
+            roaring::api::roaring_bitmap_add_bulk(&roaring, &context.context, x);
+        }
+
+        /**
+         * Check if value x is present, reusing the container cached in the
+         * context when possible. Probes in increasing order of their 16 most
+         * significant bits are the fastest.
+         */
+        bool containsBulk(BulkContext &context, uint32_t x) const noexcept {
+            return roaring::api::roaring_bitmap_contains_bulk(&roaring, &context.context, x);
+        }
+
+        /**
+         * Add the n values in vals, which may come in any order. Values are
+         * handled in batches; a batch whose 16 most significant bits are not
+         * already non-decreasing is sorted first so that each container is
+         * looked up once per batch rather than once per value.
+         */
+        void addManyUnsorted(size_t n, const uint32_t *vals) noexcept {
+            uint32_t buffer[kBulkBatchSize];
+            while (n > 0) {
+                size_t count = n < kBulkBatchSize ? n : kBulkBatchSize;
+                roaring::api::roaring_bitmap_add_many(&roaring, count,
+                                                      sortedBatch(vals, count, buffer));
+                vals += count;
+                n -= count;
+            }
+        }
+
+        /**
+         * Remove the n values in vals, which may come in any order. Batched
+         * like addManyUnsorted().
+         */
+        void removeMany(size_t n, const uint32_t *vals) noexcept {
+            uint32_t buffer[kBulkBatchSize];
+            while (n > 0 && !isEmpty()) {
+                size_t count = n < kBulkBatchSize ? n : kBulkBatchSize;
+                roaring::api::roaring_bitmap_remove_many(&roaring, count,
+                                                         sortedBatch(vals, count, buffer));
+                vals += count;
+                n -= count;
+            }
+        }
+
+        /**
+         * Check the n values in vals, which may come in any order, and set
+         * result[i] to whether vals[i] is present. Probes are batched and
+         * visited in container order behind the scenes; the results keep the
+         * order of the input. Returns how many of the values are present.
+         */
+        size_t containsMany(size_t n, const uint32_t *vals, bool *result) const noexcept {
+            size_t found = 0;
+            uint64_t order[kBulkBatchSize];
+            while (n > 0) {
+                size_t count = n < kBulkBatchSize ? n : kBulkBatchSize;
+                BulkContext context;
+                if (highBitsSorted(vals, count)) {
+                    for (size_t i = 0; i < count; ++i) {
+                        result[i] = containsBulk(context, vals[i]);
+                        found += result[i];
+                    }
+                } else {
+                    // value in the upper half, position in the lower half
+                    for (size_t i = 0; i < count; ++i) {
+                        order[i] = (uint64_t(vals[i]) << 32) | i;
+                    }
+                    std::sort(order, order + count);
+                    for (size_t i = 0; i < count; ++i) {
+                        bool present = containsBulk(context, uint32_t(order[i] >> 32));
+                        result[uint32_t(order[i])] = present;
+                        found += present;
+                    }
+                }
+                vals += count;
+                result += count;
+                n -= count;
+            }
+            return found;
+        }
+
+        /**
+         * Check the n values in vals and write the answers as a bitmask:
+         * bit i % 64 of result[i / 64] tells whether vals[i] is present.
+         * result needs (n + 63) / 64 words and is fully overwritten. Runs of
+         * probes sharing their 16 most significant bits are checked against
+         * their container together, without branching on the values, so
+         * probes grouped by high bits are the fastest. Returns how many of the
+         * values are present.
+         */
+        size_t containsMany(size_t n, const uint32_t *vals, uint64_t *result) const noexcept {
+            return roaring::api::roaring_bitmap_contains_many(&roaring, n, vals, result);
+        }
+
+        /**
+         * Copy the values of vals that are present to out, keeping their
+         * order, and return how many were copied. out needs room for n values.
+         */
+        size_t containsManyCompact(size_t n, const uint32_t *vals, uint32_t *out) const noexcept {
+            return roaring::api::roaring_bitmap_contains_many_compact(&roaring, n, vals, out);
+        }
+
         /**
          * Destructor.  By contract, calling roaring_bitmap_clear() is enough to
          * release all auxiliary memory used by the structure.
@@ -424,6 +564,15 @@ namespace bluebird {
          */
         bool runOptimize() noexcept { return roaring::api::roaring_bitmap_run_optimize(&roaring); }
 
+        /**
+         * Same as runOptimize(), but keep as bitsets the dense containers
+         * that would be slow to query as runs for the given access pattern,
+         * e.g. the one suggested by roaring_profile_suggest().
+         */
+        bool runOptimize(roaring::api::roaring_access_pattern_t pattern) noexcept {
+            return roaring::api::roaring_bitmap_run_optimize_for(&roaring, pattern);
+        }
+
         /**
          * If needed, reallocate memory to shrink the memory usage. Returns
          * the number of bytes saved.
@@ -502,6 +651,83 @@ namespace bluebird {
             return roaring::api::roaring_bitmap_xor_cardinality(&roaring, &r.roaring);
         }
 
+        /**
+         * Returns the number of values in [range_start, range_end).
+         */
+        uint64_t range_cardinality(uint64_t range_start, uint64_t range_end) const noexcept {
+            return roaring::api::roaring_bitmap_range_cardinality(&roaring, range_start, range_end);
+        }
+
+        /**
+         * Computes the intersection between two bitmaps restricted to the
+         * values in [range_start, range_end), and returns new bitmap. Only the
+         * containers whose keys fall in the range are visited.
+         */
+        Bitmap and_range(const Bitmap &r, uint64_t range_start, uint64_t range_end) const {
+            roaring_bitmap_t *ans = roaring::api::roaring_bitmap_and_range(
+                    &roaring, &r.roaring, range_start, range_end);
+            if (ans == NULL) {
+                ROARING_TERMINATE("failed materalization in and_range");
+            }
+            return Bitmap(ans);
+        }
+
+        /**
+         * Computes the union between two bitmaps restricted to the values in
+         * [range_start, range_end), and returns new bitmap.
+         */
+        Bitmap or_range(const Bitmap &r, uint64_t range_start, uint64_t range_end) const {
+            roaring_bitmap_t *ans = roaring::api::roaring_bitmap_or_range(
+                    &roaring, &r.roaring, range_start, range_end);
+            if (ans == NULL) {
+                ROARING_TERMINATE("failed materalization in or_range");
+            }
+            return Bitmap(ans);
+        }
+
+        /**
+         * Computes the difference between two bitmaps restricted to the
+         * values in [range_start, range_end), and returns new bitmap.
+         */
+        Bitmap andnot_range(const Bitmap &r, uint64_t range_start, uint64_t range_end) const {
+            roaring_bitmap_t *ans = roaring::api::roaring_bitmap_andnot_range(
+                    &roaring, &r.roaring, range_start, range_end);
+            if (ans == NULL) {
+                ROARING_TERMINATE("failed materalization in andnot_range");
+            }
+            return Bitmap(ans);
+        }
+
+        /**
+         * Computes the size of the intersection between two bitmaps, counting
+         * only the values in [range_start, range_end).
+         */
+        uint64_t and_cardinality_range(const Bitmap &r, uint64_t range_start,
+                                       uint64_t range_end) const noexcept {
+            return roaring::api::roaring_bitmap_and_cardinality_range(
+                    &roaring, &r.roaring, range_start, range_end);
+        }
+
+        /**
+         * Computes the size of the union between two bitmaps, counting only
+         * the values in [range_start, range_end).
+         */
+        uint64_t or_cardinality_range(const Bitmap &r, uint64_t range_start,
+                                      uint64_t range_end) const noexcept {
+            return roaring::api::roaring_bitmap_or_cardinality_range(
+                    &roaring, &r.roaring, range_start, range_end);
+        }
+
+        /**
+         * Computes the size of the difference between two bitmaps, counting
+         * only the values in [range_start, range_end).
+         */
+        uint64_t andnot_cardinality_range(const Bitmap &r, uint64_t range_start,
+                                          uint64_t range_end) const noexcept {
+            return roaring::api::roaring_bitmap_andnot_cardinality_range(
+                    &roaring, &r.roaring, range_start, range_end);
+        }
+
         /**
          * Returns the number of integers that are smaller or equal to x.
          * Thus the rank of the smallest element is one.  If
@@ -525,6 +751,74 @@ namespace bluebird {
             return roaring::api::roaring_bitmap_get_index(&roaring, x);
         }
 
+        /**
+         * Cumulative counts over a bitmap for repeated rank(), select() and
+         * getIndex() queries: these cost a binary search over the containers
+         * plus a small constant within the container, instead of a scan over
+         * all preceding containers.
+         *
+         * The index refers to the bitmap it was built from, which must
+         * outlive it. Call rebuild() after modifying the bitmap.
+         */
+        class RankIndex {
+        public:
+            explicit RankIndex(const Bitmap &r) : bitmap(&r), index{} {
+                rebuild();
+            }
+
+            RankIndex(const RankIndex &) = delete;
+
+            RankIndex &operator=(const RankIndex &) = delete;
+
+            RankIndex(RankIndex &&o) noexcept: bitmap(o.bitmap), index(o.index) {
+                o.index = {};
+            }
+
+            RankIndex &operator=(RankIndex &&o) noexcept {
+                std::swap(bitmap, o.bitmap);
+                std::swap(index, o.index);
+                return *this;
+            }
+
+            ~RankIndex() { roaring::api::roaring_rank_index_clear(&index); }
+
+            /**
+             * Bring the index up to date with the bitmap.
+             */
+            void rebuild() {
+                roaring::api::roaring_rank_index_clear(&index);
+                if (!roaring::api::roaring_rank_index_init(&index, &bitmap->roaring)) {
+                    ROARING_TERMINATE("failed memory alloc in RankIndex");
+                }
+            }
+
+            /**
+             * Same as Bitmap::rank().
+             */
+            uint64_t rank(uint32_t x) const noexcept {
+                return roaring::api::roaring_bitmap_rank_indexed(&bitmap->roaring, &index, x);
+            }
+
+            /**
+             * Same as Bitmap::select().
+             */
+            bool select(uint32_t rnk, uint32_t *element) const noexcept {
+                return roaring::api::roaring_bitmap_select_indexed(&bitmap->roaring, &index,
+                                                                   rnk, element);
+            }
+
+            /**
+             * Same as Bitmap::getIndex().
+             */
+            int64_t getIndex(uint32_t x) const noexcept {
+                return roaring::api::roaring_bitmap_get_index_indexed(&bitmap->roaring, &index, x);
+            }
+
+        private:
+            const Bitmap *bitmap;
+            roaring::api::roaring_rank_index_t index;
+        };
+
         /**
          * Write a bitmap to a char buffer. This is meant to be compatible with
          * the Java and Go versions. Returns how many bytes were written which
@@ -580,6 +874,10 @@ namespace bluebird {
          * can save space compared to the portable format (e.g., for very
          * sparse bitmaps).
          *
+         * Buffers written by writePacked(), writeCompressed() or
+         * writeChecksummed() are recognized by their cookie and read as well
+         * when the portable flag is set.
+         *
          * This function is unsafe in the sense that if you provide bad data,
          * many, many bytes could be read. See also readSafe.
          *
@@ -589,6 +887,12 @@ namespace bluebird {
          * ensure that the data you load come from a serialized bitmap.
          */
         static Bitmap read(const char *buf, bool portable = true) {
+            if (portable && roaring::api::roaring_bitmap_is_packed_serialization(buf, SIZE_MAX)) {
+                return readPacked(buf, SIZE_MAX);
+            }
+            if (portable && roaring::api::roaring_bitmap_is_checksummed_serialization(buf, SIZE_MAX)) {
+                return readChecksummed(buf, SIZE_MAX);
+            }
             roaring_bitmap_t *r = portable
                                   ? roaring::api::roaring_bitmap_portable_deserialize(buf)
                                   : roaring::api::roaring_bitmap_deserialize(buf);
@@ -612,7 +916,9 @@ namespace bluebird {
          * run containers should be in sorted non-overlapping order. This is is guaranteed to
          * happen when serializing an existing bitmap, but not for random inputs.
          * Note that this function assumes that your bitmap was serialized in *portable* mode
-         * (which is the default with the 'write' method).
+         * (which is the default with the 'write' method), or with writePacked(),
+         * writeCompressed() or writeChecksummed(); the formats are told apart by
+         * their cookie.
          *
          * The function may throw std::runtime_error if a bitmap could not be read. Not that even
          * if it does not throw, the bitmap could still be unusable if the loaded
@@ -620,6 +926,12 @@ namespace bluebird {
          * ensure that the data you load come from a serialized bitmap.
          */
         static Bitmap readSafe(const char *buf, size_t maxbytes) {
+            if (roaring::api::roaring_bitmap_is_packed_serialization(buf, maxbytes)) {
+                return readPacked(buf, maxbytes);
+            }
+            if (roaring::api::roaring_bitmap_is_checksummed_serialization(buf, maxbytes)) {
+                return readChecksummed(buf, maxbytes);
+            }
             roaring_bitmap_t *r =
                     roaring::api::roaring_bitmap_portable_deserialize_safe(buf, maxbytes);
             if (r == NULL) {
@@ -644,6 +956,63 @@ namespace bluebird {
             }
         }
 
+        /**
+         * Write the bitmap in the packed format, where array and bitset
+         * containers are stored delta bitpacked when that is smaller; see
+         * roaring_bitmap_packed_serialize(). Returns how many bytes were
+         * written, getPackedSizeInBytes(). read() and readSafe() recognize
+         * the format.
+         */
+        size_t writePacked(char *buf) const noexcept {
+            return roaring::api::roaring_bitmap_packed_serialize(&roaring, buf);
+        }
+
+        /**
+         * How many bytes writePacked() needs.
+         */
+        size_t getPackedSizeInBytes() const noexcept {
+            return roaring::api::roaring_bitmap_packed_size_in_bytes(&roaring);
+        }
+
+        /**
+         * Write the bitmap in the compressed variant of the packed format,
+         * meant for cold storage: containers may also be stored as
+         * delta+varint values or as runs of empty, full and literal bitset
+         * words; see roaring_bitmap_compressed_serialize(). Returns how many
+         * bytes were written, getCompressedSizeInBytes(). read() and
+         * readSafe() recognize the format.
+         */
+        size_t writeCompressed(char *buf) const noexcept {
+            return roaring::api::roaring_bitmap_compressed_serialize(&roaring, buf);
+        }
+
+        /**
+         * How many bytes writeCompressed() needs.
+         */
+        size_t getCompressedSizeInBytes() const noexcept {
+            return roaring::api::roaring_bitmap_compressed_size_in_bytes(&roaring);
+        }
+
+        /**
+         * Write the bitmap in the checksummed format, where every container
+         * carries a CRC32C of its payload; see
+         * roaring_bitmap_checksummed_serialize(). Returns how many bytes were
+         * written, getChecksummedSizeInBytes(). read() and readSafe()
+         * recognize the format and check every checksum; to check only the
+         * containers actually queried, see ChecksummedBitmapView in
+         * bluebird/bits/checksummed_bitmap.h.
+         */
+        size_t writeChecksummed(char *buf) const noexcept {
+            return roaring::api::roaring_bitmap_checksummed_serialize(&roaring, buf);
+        }
+
+        /**
+         * How many bytes writeChecksummed() needs.
+         */
+        size_t getChecksummedSizeInBytes() const noexcept {
+            return roaring::api::roaring_bitmap_checksummed_size_in_bytes(&roaring);
+        }
+
         /**
          * For advanced users.
          * This function may throw std::runtime_error.
@@ -730,6 +1099,31 @@ namespace bluebird {
             return Bitmap(r);
         }
 
+        /**
+         * Returns a copy of the bitmap with 'offset' added to every value.
+         * Values that land outside of [0, 2^32) are dropped. Containers are
+         * moved whole, and split in two only when 'offset' is not a multiple
+         * of 2^16.
+         */
+        Bitmap shifted(int64_t offset) const {
+            roaring_bitmap_t *r = roaring::api::roaring_bitmap_add_offset(&roaring, offset);
+            if (r == NULL) {
+                ROARING_TERMINATE("failed materalization in shifted");
+            }
+            return Bitmap(r);
+        }
+
+        /**
+         * Adds 'offset' to every value, dropping the values that land outside
+         * of [0, 2^32). When 'offset' is a multiple of 2^16 only the container
+         * keys are rewritten; otherwise this is *this = shifted(offset).
+         */
+        void shift(int64_t offset) {
+            if (!roaring::api::roaring_bitmap_add_offset_inplace(&roaring, offset)) {
+                *this = shifted(offset);
+            }
+        }
+
         /**
          * Whether or not we apply copy and write.
          */
@@ -797,6 +1191,141 @@ namespace bluebird {
             return ans;
         }
 
+        /**
+         * Computes the symmetric union (xor) between "n" bitmaps (referenced by
+         * a pointer).
+         * This function may throw std::runtime_error.
+         */
+        static Bitmap fastxor(size_t n, const Bitmap **inputs) {
+            const roaring_bitmap_t **x =
+                    (const roaring_bitmap_t **) roaring_malloc(n * sizeof(roaring_bitmap_t *));
+            if (x == NULL) {
+                ROARING_TERMINATE("failed memory alloc in fastxor");
+            }
+            for (size_t k = 0; k < n; ++k) x[k] = &inputs[k]->roaring;
+
+            roaring_bitmap_t *c_ans = roaring::api::roaring_bitmap_xor_many(n, x);
+            if (c_ans == NULL) {
+                roaring_free(x);
+                ROARING_TERMINATE("failed memory alloc in fastxor");
+            }
+            Bitmap ans(c_ans);
+            roaring_free(x);
+            return ans;
+        }
+
+        /**
+         * Computes the logical or (union) between "n" bitmaps on several
+         * threads. The 16-bit key space is cut into up to
+         * executor.concurrency() ranges holding about the same number of
+         * input containers, each range is united by its own task, and the
+         * partial results are stitched together by moving their containers.
+         *
+         * See bluebird/bits/executor.h for what an executor must provide;
+         * bluebird::ThreadExecutor is a ready-made one.
+         * This function may throw std::runtime_error.
+         */
+        template<typename Executor>
+        static Bitmap fastunion(size_t n, const Bitmap **inputs, Executor &&executor) {
+            return manyByKeyRange(n, inputs, executor, false);
+        }
+
+        /**
+         * Computes the symmetric union (xor) between "n" bitmaps on several
+         * threads, splitting the work by key range as fastunion does.
+         * This function may throw std::runtime_error.
+         */
+        template<typename Executor>
+        static Bitmap fastxor(size_t n, const Bitmap **inputs, Executor &&executor) {
+            return manyByKeyRange(n, inputs, executor, true);
+        }
+
+        /**
+         * Merges "n" index segments into one bitmap: the values of inputs[i]
+         * that are not in deletions[i], plus offsets[i]. 'deletions' and any
+         * of its entries may be null. Values that land outside of [0, 2^32)
+         * are dropped.
+         *
+         * Containers are moved to the result in key order rather than added
+         * value by value, so inputs sorted by offset, with disjoint shifted
+         * ranges, are merged in one pass.
+         * This function may throw std::runtime_error.
+         */
+        static Bitmap mergeSegments(size_t n, const Bitmap **inputs, const int64_t *offsets,
+                                    const Bitmap **deletions = nullptr) {
+            std::vector<const roaring_bitmap_t *> x(n);
+            std::vector<const roaring_bitmap_t *> d(deletions == nullptr ? 0 : n);
+            for (size_t k = 0; k < n; ++k) {
+                x[k] = &inputs[k]->roaring;
+                if (deletions != nullptr) {
+                    d[k] = deletions[k] == nullptr ? nullptr : &deletions[k]->roaring;
+                }
+            }
+            roaring_bitmap_t *c_ans = roaring::api::roaring_bitmap_merge_segments(
+                    n, x.data(), offsets, deletions == nullptr ? nullptr : d.data());
+            if (c_ans == NULL) {
+                ROARING_TERMINATE("failed memory alloc in mergeSegments");
+            }
+            return Bitmap(c_ans);
+        }
+
+        /**
+         * An executor for the functions that take one, running their tasks
+         * one after the other on the calling thread.
+         */
+        struct SerialExecutor {
+            size_t concurrency() const noexcept { return 1; }
+
+            template<typename Task>
+            void run(size_t n, Task &&task) const {
+                for (size_t i = 0; i < n; ++i) {
+                    task(i);
+                }
+            }
+        };
+
+        /**
+         * Returns the bitmap of mapping[x] for every x in this bitmap, e.g. to
+         * follow a reordering of the ids. 'mapping' must have an entry for
+         * every value up to maximum(); it need not be a permutation.
+         *
+         * The containers are decoded in bulk and their values translated, then
+         * grouped by new high 16 bits with a counting pass and turned into
+         * containers directly, without sorting nor inserting them one by one.
+         * No run container is created: call runOptimize() on the result if
+         * wanted.
+         * This function may throw std::runtime_error.
+         */
+        Bitmap remap(const uint32_t *mapping) const {
+            SerialExecutor serial;
+            return remapWith(mapping, serial);
+        }
+
+        /**
+         * Same as remap(mapping), with each of its passes split between
+         * executor.concurrency() tasks: for large bitmaps.
+         *
+         * See bluebird/bits/executor.h for what an executor must provide.
+         * This function may throw std::runtime_error.
+         */
+        template<typename Executor>
+        Bitmap remap(const uint32_t *mapping, Executor &&executor) const {
+            return remapWith(mapping, executor);
+        }
+
+        /**
+         * Builds a bitmap from the n values of 'vals', in any order and with
+         * repeats, on several threads. The values are grouped by their 16 high
+         * bits with a counting pass split between executor.concurrency()
+         * tasks, and each range of keys is turned into containers by its own
+         * task. See BitmapBuilder for the single-threaded version.
+         * This function may throw std::runtime_error.
+         */
+        template<typename Executor>
+        static Bitmap fromUnsorted(size_t n, const uint32_t *vals, Executor &&executor) {
+            return groupWith(vals, n, executor, false);
+        }
+
         typedef BitmapSetBitForwardIterator const_iterator;
 
         /**
@@ -817,6 +1346,303 @@ namespace bluebird {
         const_iterator &end() const;
 
         roaring_bitmap_t roaring;
+
+    private:
+        friend class Bitmap64;
+
+        /**
+         * Batch size of the unsorted bulk operations: small enough for the
+         * scratch buffers to live on the stack and the sort to stay in cache.
+         */
+        static constexpr size_t kBulkBatchSize = 1024;
+
+        /**
+         * Fewest values per task in the parallel counting passes: below that,
+         * clearing and summing the 2^16 counters of a task costs more than
+         * the values it handles.
+         */
+        static constexpr size_t kGroupMinSlice = size_t(1) << 16;
+
+        static Bitmap readPacked(const char *buf, size_t maxbytes) {
+            roaring_bitmap_t *r =
+                    roaring::api::roaring_bitmap_packed_deserialize_safe(buf, maxbytes);
+            if (r == NULL) {
+                ROARING_TERMINATE("failed to read packed bitmap");
+            }
+            return Bitmap(r);
+        }
+
+        static Bitmap readChecksummed(const char *buf, size_t maxbytes) {
+            roaring_bitmap_t *r =
+                    roaring::api::roaring_bitmap_checksummed_deserialize_safe(buf, maxbytes);
+            if (r == NULL) {
+                ROARING_TERMINATE("failed to read checksummed bitmap");
+            }
+            return Bitmap(r);
+        }
+
+        static bool highBitsSorted(const uint32_t *vals, size_t n) noexcept {
+            for (size_t i = 1; i < n; ++i) {
+                if ((vals[i] >> 16) < (vals[i - 1] >> 16)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * Return vals itself if it is already grouped by container, otherwise
+         * a sorted copy of it made in buffer.
+         */
+        static const uint32_t *sortedBatch(const uint32_t *vals, size_t n,
+                                           uint32_t *buffer) noexcept {
+            if (highBitsSorted(vals, n)) {
+                return vals;
+            }
+            std::copy(vals, vals + n, buffer);
+            std::sort(buffer, buffer + n);
+            return buffer;
+        }
+
+        template<typename Executor>
+        static Bitmap manyByKeyRange(size_t n, const Bitmap **inputs,
+                                     Executor &executor, bool use_xor) {
+            // Weigh every key by the number of input containers it has, and
+            // cut the key space where the running weight crosses 1/parts.
+            std::vector<uint32_t> weights(size_t(1) << 16, 0);
+            uint64_t total = 0;
+            bool cow = false;
+            for (size_t k = 0; k < n; ++k) {
+                const auto &ra = inputs[k]->roaring.high_low_container;
+                for (int32_t i = 0; i < ra.size; ++i) {
+                    weights[ra.keys[i]]++;
+                }
+                total += ra.size;
+                cow = cow || inputs[k]->getCopyOnWrite();
+            }
+            size_t parts = executor.concurrency();
+            if (parts > total) {
+                parts = size_t(total);
+            }
+            if (parts <= 1 || n < 2) {
+                return use_xor ? fastxor(n, inputs) : fastunion(n, inputs);
+            }
+            std::vector<uint32_t> bounds = splitByWeight(weights, total, parts);
+
+            std::vector<const roaring_bitmap_t *> x(n);
+            for (size_t k = 0; k < n; ++k) x[k] = &inputs[k]->roaring;
+            std::vector<roaring_bitmap_t *> partial(bounds.size() - 1, nullptr);
+            auto release = [&partial]() {
+                for (auto *p: partial) {
+                    if (p != nullptr) roaring::api::roaring_bitmap_free(p);
+                }
+            };
+            try {
+                executor.run(partial.size(), [&](size_t p) {
+                    partial[p] = use_xor
+                                 ? roaring::api::roaring_bitmap_xor_many_key_range(
+                                    n, x.data(), bounds[p], bounds[p + 1])
+                                 : roaring::api::roaring_bitmap_or_many_key_range(
+                                    n, x.data(), bounds[p], bounds[p + 1]);
+                });
+            } catch (...) {
+                release();
+                throw;
+            }
+
+            return concatenate(partial, cow, "failed memory alloc in fastunion");
+        }
+
+        /**
+         * Concatenate bitmaps covering ordered, disjoint key ranges by moving
+         * their container pointers, and free them. Null entries are failed
+         * allocations.
+         */
+        static Bitmap concatenate(std::vector<roaring_bitmap_t *> &partial, bool cow,
+                                  const char *failure) {
+            auto release = [&partial]() {
+                for (auto *p: partial) {
+                    if (p != nullptr) roaring::api::roaring_bitmap_free(p);
+                }
+            };
+            int32_t containers = 0;
+            for (auto *p: partial) {
+                if (p == nullptr) {
+                    release();
+                    ROARING_TERMINATE(failure);
+                }
+                containers += p->high_low_container.size;
+            }
+            Bitmap ans;
+            if (!roaring::internal::extend_array(&ans.roaring.high_low_container, containers)) {
+                release();
+                ROARING_TERMINATE(failure);
+            }
+            for (auto *&p: partial) {
+                roaring::internal::ra_append_move_range(&ans.roaring.high_low_container,
+                                                        &p->high_low_container, 0,
+                                                        p->high_low_container.size);
+                roaring::internal::ra_clear_without_containers(&p->high_low_container);
+                roaring_free(p);
+                p = nullptr;
+            }
+            ans.setCopyOnWrite(cow);
+            return ans;
+        }
+
+        /**
+         * Split [0, weights.size()) into up to 'parts' ranges of about equal
+         * total weight. Returns the bounds, first 0 and last weights.size().
+         */
+        template<typename Weight>
+        static std::vector<uint32_t> splitByWeight(const std::vector<Weight> &weights,
+                                                   uint64_t total, size_t parts) {
+            std::vector<uint32_t> bounds{0};
+            uint64_t running = 0;
+            for (uint32_t i = 0; i + 1 < weights.size() && bounds.size() < parts; ++i) {
+                running += weights[i];
+                if (running * parts >= total * bounds.size()) {
+                    bounds.push_back(i + 1);
+                }
+            }
+            bounds.push_back(uint32_t(weights.size()));
+            return bounds;
+        }
+
+        template<typename Executor>
+        Bitmap remapWith(const uint32_t *mapping, Executor &executor) const {
+            namespace internal = roaring::internal;
+            const auto &ra = roaring.high_low_container;
+
+            // Cut the source containers into slices of about the same
+            // cardinality; slice p fills mapped[offsets[p], offsets[p + 1]).
+            std::vector<uint32_t> cards(size_t(ra.size));
+            uint64_t total = 0;
+            for (int32_t i = 0; i < ra.size; ++i) {
+                cards[i] = uint32_t(internal::container_get_cardinality(ra.containers[i],
+                                                                       ra.typecodes[i]));
+                total += cards[i];
+            }
+            size_t parts = executor.concurrency();
+            if (parts > total / kGroupMinSlice) {
+                parts = size_t(total / kGroupMinSlice);
+            }
+            if (parts == 0) {
+                parts = 1;
+            }
+            std::vector<uint32_t> slices = splitByWeight(cards, total, parts);
+            parts = slices.size() - 1;
+            std::vector<uint64_t> offsets(parts + 1, 0);
+            for (size_t p = 0; p < parts; ++p) {
+                offsets[p + 1] = offsets[p];
+                for (uint32_t i = slices[p]; i < slices[p + 1]; ++i) {
+                    offsets[p + 1] += cards[i];
+                }
+            }
+
+            // Decode each container (bitsets with the vectorized extraction of
+            // the core) and translate its values in place.
+            std::vector<uint32_t> mapped(total);
+            executor.run(parts, [&](size_t p) {
+                uint32_t *out = mapped.data() + offsets[p];
+                for (uint32_t i = slices[p]; i < slices[p + 1]; ++i) {
+                    const int n = internal::container_to_uint32_array(
+                            out, ra.containers[i], ra.typecodes[i],
+                            uint32_t(ra.keys[i]) << 16);
+                    for (int j = 0; j < n; ++j) {
+                        out[j] = mapping[out[j]];
+                    }
+                    out += n;
+                }
+            });
+            return groupWith(mapped.data(), mapped.size(), executor, getCopyOnWrite());
+        }
+
+        /**
+         * Build a bitmap from 'values', in any order: a counting pass on the
+         * high 16 bits, split between the tasks by slices of 'values', then
+         * roaring_bitmap_of_grouped on ranges of keys.
+         */
+        template<typename Executor>
+        static Bitmap groupWith(const uint32_t *values, size_t total, Executor &executor,
+                                bool cow) {
+            const size_t keys = size_t(1) << 16;
+            if (total < keys) {
+                // below one value per counter, sorting is cheaper
+                std::vector<uint32_t> sorted(values, values + total);
+                std::sort(sorted.begin(), sorted.end());
+                roaring_bitmap_t *r = roaring::api::roaring_bitmap_of_grouped(total, sorted.data());
+                if (r == NULL) {
+                    ROARING_TERMINATE("failed memory alloc in grouping");
+                }
+                Bitmap ans(r);
+                ans.setCopyOnWrite(cow);
+                return ans;
+            }
+            size_t parts = executor.concurrency();
+            if (parts > total / kGroupMinSlice) {
+                parts = total / kGroupMinSlice;
+            }
+            if (parts == 0) {
+                parts = 1;
+            }
+
+            std::vector<std::vector<uint64_t>> counts(parts);
+            auto slice = [total, parts](size_t p) {
+                return total / parts * p + std::min(p, total % parts);
+            };
+            executor.run(parts, [&](size_t p) {
+                std::vector<uint64_t> &count = counts[p];
+                count.assign(keys, 0);
+                for (size_t i = slice(p); i < slice(p + 1); ++i) {
+                    count[values[i] >> 16]++;
+                }
+            });
+
+            // Slice p writes its values of key k after those of the slices
+            // before it.
+            std::vector<uint64_t> sizes(keys, 0);
+            uint64_t position = 0;
+            for (size_t k = 0; k < keys; ++k) {
+                for (size_t p = 0; p < parts; ++p) {
+                    const uint64_t n = counts[p][k];
+                    counts[p][k] = position;
+                    position += n;
+                    sizes[k] += n;
+                }
+            }
+            std::vector<uint32_t> grouped(total);
+            executor.run(parts, [&](size_t p) {
+                std::vector<uint64_t> &next = counts[p];
+                for (size_t i = slice(p); i < slice(p + 1); ++i) {
+                    const uint32_t v = values[i];
+                    grouped[next[v >> 16]++] = v;
+                }
+            });
+
+            // Build the containers of each range of keys directly.
+            std::vector<uint32_t> ranges = splitByWeight(sizes, total, parts);
+            std::vector<uint64_t> starts(ranges.size(), 0);
+            for (size_t r = 0, k = 0; r + 1 < ranges.size(); ++r) {
+                starts[r + 1] = starts[r];
+                for (; k < ranges[r + 1]; ++k) {
+                    starts[r + 1] += sizes[k];
+                }
+            }
+            std::vector<roaring_bitmap_t *> partial(ranges.size() - 1, nullptr);
+            try {
+                executor.run(partial.size(), [&](size_t r) {
+                    partial[r] = roaring::api::roaring_bitmap_of_grouped(
+                            size_t(starts[r + 1] - starts[r]), grouped.data() + starts[r]);
+                });
+            } catch (...) {
+                for (auto *p: partial) {
+                    if (p != nullptr) roaring::api::roaring_bitmap_free(p);
+                }
+                throw;
+            }
+            return concatenate(partial, cow, "failed memory alloc in grouping");
+        }
     };
 
 /**
@@ -867,6 +1693,17 @@ namespace bluebird {
             roaring::api::roaring_move_uint32_iterator_equalorlarger(&i, val);
         }
 
+        /**
+         * Move the iterator forward to the first value >= val; it never moves
+         * backwards. The search gallops from the current position, so a
+         * sequence of increasing targets (as in an intersection) costs time
+         * logarithmic in the distances skipped rather than in the bitmap size.
+         * Returns whether such a value exists.
+         */
+        bool advanceTo(uint32_t val) {
+            return roaring::api::roaring_skip_uint32_iterator_to(&i, val);
+        }
+
         type_of_iterator &operator++() {  // ++i, must returned inc. value
             roaring::api::roaring_advance_uint32_iterator(&i);
             return *this;
@@ -921,6 +1758,125 @@ namespace bluebird {
         return e;
     }
 
+    /**
+     * Resumable batch reader over the values of a bitmap, in increasing
+     * order. Each read() continues where the previous one stopped, so a large
+     * bitmap can be streamed through a fixed-size buffer without locating
+     * the offset again as rangeUint32Array() does. Bitset containers are
+     * decoded with SIMD when available, array and run containers are copied
+     * in bulk.
+     *
+     * The bitmap must outlive the cursor and must not be modified while it
+     * is in use.
+     */
+    class BitmapCursor final {
+    public:
+        explicit BitmapCursor(const Bitmap &parent) {
+            roaring::api::roaring_init_iterator(&parent.roaring, &i);
+        }
+
+        /**
+         * Write up to 'max' of the next values to 'out' and return how many
+         * were written; fewer than 'max' only once the bitmap is exhausted.
+         */
+        size_t read(uint32_t *out, size_t max) {
+            size_t total = 0;
+            while (max - total > 0 && i.has_value) {
+                size_t chunk = max - total;
+                if (chunk > UINT32_MAX) chunk = UINT32_MAX;
+                total += roaring::api::roaring_read_uint32_iterator(&i, out + total,
+                                                                   uint32_t(chunk));
+            }
+            return total;
+        }
+
+        /**
+         * Whether read() has values left to return.
+         */
+        bool hasNext() const { return i.has_value; }
+
+        /**
+         * The value the next read() starts with. Requires hasNext().
+         */
+        uint32_t peek() const { return i.current_value; }
+
+        /**
+         * Reposition the cursor at the first value >= val, which moves it
+         * backwards if val precedes the current position. Returns whether
+         * such a value exists.
+         */
+        bool seek(uint32_t val) {
+            return roaring::api::roaring_move_uint32_iterator_equalorlarger(&i, val);
+        }
+
+        /**
+         * Move forward to the first value >= val, galloping from the current
+         * position; unlike seek() it never moves backwards. Returns whether
+         * such a value exists.
+         */
+        bool advanceTo(uint32_t val) {
+            return roaring::api::roaring_skip_uint32_iterator_to(&i, val);
+        }
+
+        /**
+         * Go back to the smallest value.
+         */
+        void rewind() { roaring::api::roaring_init_iterator(i.parent, &i); }
+
+    private:
+        roaring::api::roaring_uint32_iterator_t i{};
+    };
+
+    /**
+     * Resumable batch reader over the values of a bitmap, in decreasing
+     * order. It is the reverse counterpart of BitmapCursor: every container
+     * is emitted in bulk from its last value down, instead of one
+     * operator--() call per value.
+     *
+     * The bitmap must outlive the cursor and must not be modified while it
+     * is in use.
+     */
+    class BitmapReverseCursor final {
+    public:
+        explicit BitmapReverseCursor(const Bitmap &parent) {
+            roaring::api::roaring_init_iterator_last(&parent.roaring, &i);
+        }
+
+        /**
+         * Write up to 'max' of the next smaller values to 'out' and return how
+         * many were written; fewer than 'max' only once the bitmap is
+         * exhausted.
+         */
+        size_t read(uint32_t *out, size_t max) {
+            size_t total = 0;
+            while (max - total > 0 && i.has_value) {
+                size_t chunk = max - total;
+                if (chunk > UINT32_MAX) chunk = UINT32_MAX;
+                total += roaring::api::roaring_read_previous_uint32_iterator(
+                        &i, out + total, uint32_t(chunk));
+            }
+            return total;
+        }
+
+        /**
+         * Whether read() has values left to return.
+         */
+        bool hasNext() const { return i.has_value; }
+
+        /**
+         * The value the next read() starts with. Requires hasNext().
+         */
+        uint32_t peek() const { return i.current_value; }
+
+        /**
+         * Go back to the largest value.
+         */
+        void rewind() { roaring::api::roaring_init_iterator_last(i.parent, &i); }
+
+    private:
+        roaring::api::roaring_uint32_iterator_t i{};
+    };
+
 }  // namespace bluebird
 
 #endif  // BLUEBIRD_BITS_BITMAP_H_
@@ -23,7 +23,9 @@
 #include <queue>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "bluebird/bits/bitmap.h"
 
@@ -35,6 +37,12 @@ namespace bluebird {
 
     class Bitmap64SetBitBiDirectionalIterator;
 
+    class Bitmap64Cursor;
+
+    class Bitmap64ReverseCursor;
+
+    class ChecksummedBitmap64View;
+
     class Bitmap64 {
         typedef roaring::api::roaring_bitmap_t roaring_bitmap_t;
 
@@ -82,7 +90,16 @@ namespace bluebird {
 
         Bitmap64(const Bitmap64 &r) = default;
 
-        Bitmap64(Bitmap64 &&r) noexcept = default;
+        /**
+         * Move constructor. The moved-from bitmap is left empty, without a
+         * cardinality index.
+         */
+        Bitmap64(Bitmap64 &&r) noexcept
+                : roarings(std::move(r.roarings)), copyOnWrite(r.copyOnWrite),
+                  cardIndex(std::move(r.cardIndex)) {
+            r.roarings.clear();
+            r.cardIndex = CardinalityIndex{};
+        }
 
         /**
          * Copy assignment operator.
@@ -90,9 +107,19 @@ namespace bluebird {
         Bitmap64 &operator=(const Bitmap64 &r) = default;
 
         /**
-         * Move assignment operator.
+         * Move assignment operator. The moved-from bitmap is left empty,
+         * without a cardinality index.
          */
-        Bitmap64 &operator=(Bitmap64 &&r) noexcept = default;
+        Bitmap64 &operator=(Bitmap64 &&r) noexcept {
+            if (this != &r) {
+                roarings = std::move(r.roarings);
+                copyOnWrite = r.copyOnWrite;
+                cardIndex = std::move(r.cardIndex);
+                r.roarings.clear();
+                r.cardIndex = CardinalityIndex{};
+            }
+            return *this;
+        }
 
         /**
          * Assignment from an initializer list.
@@ -251,20 +278,180 @@ namespace bluebird {
          * Adds 'n_args' values from the contiguous memory range starting at 'vals'.
          */
         void addMany(size_t n_args, const uint64_t *vals) {
-            // Potentially reduce outer map lookups by optimistically
-            // assuming that adjacent values will belong to the same inner bitmap.
-            Bitmap *last_inner_bitmap = nullptr;
-            uint32_t last_value_high = 0;
-            for (size_t lcv = 0; lcv < n_args; lcv++) {
-                auto value = vals[lcv];
-                auto value_high = highBytes(value);
-                auto value_low = lowBytes(value);
-                if (last_inner_bitmap == nullptr || value_high != last_value_high) {
-                    last_inner_bitmap = &lookupOrCreateInner(value_high);
-                    last_value_high = value_high;
+            // Each run of values sharing their high 32 bits costs a single
+            // outer map lookup; its low halves go to the inner bitmap in
+            // batches so that they take the 32-bit bulk path.
+            uint32_t lows[kBulkBatchSize];
+            size_t lcv = 0;
+            while (lcv < n_args) {
+                const uint32_t high = highBytes(vals[lcv]);
+                Bitmap &inner = lookupOrCreateInner(high);
+                size_t count = 0;
+                for (; lcv < n_args && highBytes(vals[lcv]) == high; ++lcv) {
+                    lows[count++] = lowBytes(vals[lcv]);
+                    if (count == kBulkBatchSize) {
+                        inner.addMany(count, lows);
+                        count = 0;
+                    }
+                }
+                inner.addMany(count, lows);
+            }
+        }
+
+        /**
+         * Remembers the inner bitmap and container last touched by addBulk()
+         * or containsBulk(), so that consecutive values sharing their high
+         * bits skip both the outer map lookup and the container lookup.
+         *
+         * A context must only be used with the bitmap it was first used with,
+         * and becomes invalid as soon as that bitmap is modified by any other
+         * means than addBulk() with the same context.
+         */
+        class BulkContext {
+        public:
+            friend class Bitmap64;
+
+            BulkContext() noexcept = default;
+
+            BulkContext(const BulkContext &) = delete;
+
+            BulkContext &operator=(const BulkContext &) = delete;
+
+            BulkContext(BulkContext &&) noexcept = default;
+
+            BulkContext &operator=(BulkContext &&) noexcept = default;
+
+            /**
+             * Forget the cached position, e.g. after the bitmap was modified.
+             */
+            void reset() noexcept {
+                primed = false;
+                inner = nullptr;
+                context.reset();
+            }
+
+        private:
+            bool primed{false};
+            uint32_t high{0};
+            Bitmap *inner{nullptr};  // nullptr when primed on an absent key
+            Bitmap::BulkContext context{};
+        };
+
+        /**
+         * Add value x, reusing the position cached in the context when
+         * possible.
+         */
+        void addBulk(BulkContext &context, uint64_t x) {
+            const uint32_t high = highBytes(x);
+            if (!context.primed || context.inner == nullptr || context.high != high) {
+                context.inner = &lookupOrCreateInner(high);
+                context.high = high;
+                context.primed = true;
+                context.context.reset();
+            } else {
+                touchCardinalityIndex(high);
+            }
+            context.inner->addBulk(context.context, lowBytes(x));
+        }
+
+        /**
+         * Check if value x is present, reusing the position cached in the
+         * context when possible. Probes grouped by their high bits are the
+         * fastest.
+         */
+        bool containsBulk(BulkContext &context, uint64_t x) const {
+            const uint32_t high = highBytes(x);
+            if (!context.primed || context.high != high) {
+                auto iter = roarings.find(high);
+                // The context is shared with addBulk(), hence the non-const
+                // pointer; nothing is written through it from here.
+                context.inner = iter == roarings.cend()
+                                ? nullptr : const_cast<Bitmap *>(&iter->second);
+                context.high = high;
+                context.primed = true;
+                context.context.reset();
+            }
+            return context.inner != nullptr &&
+                   context.inner->containsBulk(context.context, lowBytes(x));
+        }
+
+        /**
+         * Remove the n_args values starting at 'vals', which may come in any
+         * order. Each run of values sharing their high 32 bits costs a single
+         * outer map lookup.
+         */
+        void removeMany(size_t n_args, const uint64_t *vals) {
+            uint32_t lows[kBulkBatchSize];
+            size_t lcv = 0;
+            while (lcv < n_args) {
+                const uint32_t high = highBytes(vals[lcv]);
+                auto iter = roarings.find(high);
+                size_t count = 0;
+                for (; lcv < n_args && highBytes(vals[lcv]) == high; ++lcv) {
+                    if (iter == roarings.end()) {
+                        continue;
+                    }
+                    lows[count++] = lowBytes(vals[lcv]);
+                    if (count == kBulkBatchSize) {
+                        iter->second.removeMany(count, lows);
+                        count = 0;
+                    }
+                }
+                if (iter != roarings.end()) {
+                    iter->second.removeMany(count, lows);
+                    eraseIfEmpty(iter);
+                }
+            }
+        }
+
+        /**
+         * Check the n_args values starting at 'vals' and set result[i] to
+         * whether vals[i] is present. Returns how many values are present.
+         */
+        size_t containsMany(size_t n_args, const uint64_t *vals, bool *result) const {
+            size_t found = 0;
+            BulkContext context;
+            for (size_t lcv = 0; lcv < n_args; ++lcv) {
+                result[lcv] = containsBulk(context, vals[lcv]);
+                found += result[lcv];
+            }
+            return found;
+        }
+
+        /**
+         * Check the n_args values starting at 'vals' and write the answers as
+         * a bitmask: bit i % 64 of result[i / 64] tells whether vals[i] is
+         * present. result needs (n_args + 63) / 64 words and is fully
+         * overwritten. Each run of values sharing their high 32 bits is
+         * handed to the batched 32-bit membership test of its inner bitmap.
+         * Returns how many values are present.
+         */
+        size_t containsMany(size_t n_args, const uint64_t *vals, uint64_t *result) const {
+            std::fill(result, result + (n_args + 63) / 64, uint64_t(0));
+            uint32_t lows[kBulkBatchSize];
+            uint64_t mask[kBulkBatchSize / 64];
+            size_t found = 0;
+            size_t lcv = 0;
+            while (lcv < n_args) {
+                const uint32_t high = highBytes(vals[lcv]);
+                auto iter = roarings.find(high);
+                size_t begin = lcv;
+                size_t count = 0;
+                for (; lcv < n_args && highBytes(vals[lcv]) == high; ++lcv) {
+                    if (iter == roarings.cend()) {
+                        continue;
+                    }
+                    lows[count++] = lowBytes(vals[lcv]);
+                    if (count == kBulkBatchSize || lcv + 1 == n_args ||
+                        highBytes(vals[lcv + 1]) != high) {
+                        found += iter->second.containsMany(count, lows, mask);
+                        orBits(result, begin, mask, count);
+                        begin += count;
+                        count = 0;
+                    }
                 }
-                last_inner_bitmap->add(value_low);
             }
+            return found;
         }
 
         /**
@@ -366,6 +553,7 @@ namespace bluebird {
             if (min > max) {
                 return;
             }
+            invalidateCardinalityIndex();
             uint32_t start_high = highBytes(min);
             uint32_t start_low = lowBytes(min);
             uint32_t end_high = highBytes(max);
@@ -443,6 +631,7 @@ namespace bluebird {
          */
         void clear() {
             roarings.clear();
+            invalidateCardinalityIndex();
         }
 
         /**
@@ -499,6 +688,7 @@ namespace bluebird {
          * bitmaps, two-by-two, it is best to start with the smallest bitmap.
          */
         Bitmap64 &operator&=(const Bitmap64 &other) {
+            invalidateCardinalityIndex();
             if (this == &other) {
                 // ANDing *this with itself is a no-op.
                 return *this;
@@ -556,6 +746,7 @@ namespace bluebird {
          * is not modified.
          */
         Bitmap64 &operator-=(const Bitmap64 &other) {
+            invalidateCardinalityIndex();
             if (this == &other) {
                 // Subtracting *this from itself results in the empty map.
                 roarings.clear();
@@ -624,6 +815,7 @@ namespace bluebird {
          * See also the fastunion function to aggregate many bitmaps more quickly.
          */
         Bitmap64 &operator|=(const Bitmap64 &other) {
+            invalidateCardinalityIndex();
             if (this == &other) {
                 // ORing *this with itself is a no-op.
                 return *this;
@@ -676,6 +868,7 @@ namespace bluebird {
          * the result in the current bitmap. The provided bitmap is not modified.
          */
         Bitmap64 &operator^=(const Bitmap64 &other) {
+            invalidateCardinalityIndex();
             if (this == &other) {
                 // XORing *this with itself results in the empty map.
                 roarings.clear();
@@ -733,7 +926,10 @@ namespace bluebird {
         /**
          * Exchange the content of this bitmap with another.
          */
-        void swap(Bitmap64 &r) { roarings.swap(r.roarings); }
+        void swap(Bitmap64 &r) {
+            roarings.swap(r.roarings);
+            std::swap(cardIndex, r.cardIndex);
+        }
 
         /**
          * Get the cardinality of the bitmap (number of elements).
@@ -751,6 +947,9 @@ namespace bluebird {
                                   "unable to represent in a 64-bit integer");
 #endif
             }
+            if (cardIndex.enabled) {
+                return syncCardinalityIndex().total;
+            }
             return std::accumulate(
                     roarings.cbegin(), roarings.cend(), (uint64_t) 0,
                     [](uint64_t previous,
@@ -897,6 +1096,7 @@ namespace bluebird {
          * [min, max]. Areas outside the interval are unchanged.
          */
         void flipClosed(uint32_t min, uint32_t max) {
+            touchCardinalityIndex(0);
             auto iter = roarings.begin();
             // Since min and max are uint32_t, highbytes(min or max) == 0. The inner
             // bitmap we are looking for, if it exists, will be at the first slot of
@@ -1002,6 +1202,18 @@ namespace bluebird {
                     });
         }
 
+        /**
+         * Same as runOptimize(), but keep as bitsets the dense containers
+         * that would be slow to query as runs for the given access pattern.
+         */
+        bool runOptimize(roaring::api::roaring_access_pattern_t pattern) {
+            return std::accumulate(
+                    roarings.begin(), roarings.end(), true,
+                    [pattern](bool previous, std::pair<const uint32_t, Bitmap> &map_entry) {
+                        return map_entry.second.runOptimize(pattern) && previous;
+                    });
+        }
+
         /**
          * If needed, reallocate memory to shrink the memory usage.
          * Returns the number of bytes saved.
@@ -1051,6 +1263,32 @@ namespace bluebird {
          * contents of *element are unspecified.
          */
         bool select(uint64_t rank, uint64_t *element) const {
+            if (cardIndex.enabled) {
+                const auto &ix = syncCardinalityIndex();
+                if (rank >= ix.total) {
+                    return false;
+                }
+                // Descend the Fenwick tree to the first key whose prefix sum
+                // exceeds 'rank', leaving in 'rank' the offset within it.
+                size_t n = ix.keys.size();
+                size_t pos = 0;
+                size_t step = 1;
+                while (step * 2 <= n) step *= 2;
+                for (; step != 0; step /= 2) {
+                    if (pos + step <= n && ix.tree[pos + step] <= rank) {
+                        pos += step;
+                        rank -= ix.tree[pos];
+                    }
+                }
+                const auto &bitmap = roarings.find(ix.keys[pos])->second;
+                uint32_t low_bytes;
+                if (!bitmap.select((uint32_t) rank, &low_bytes)) {
+                    ROARING_TERMINATE("Logic error: bitmap.select() "
+                                      "returned false despite rank < cardinality()");
+                }
+                *element = uniteBytes(ix.keys[pos], low_bytes);
+                return true;
+            }
             for (const auto &map_entry: roarings) {
                 auto key = map_entry.first;
                 const auto &bitmap = map_entry.second;
@@ -1076,6 +1314,14 @@ namespace bluebird {
          * Returns the number of integers that are smaller or equal to x.
          */
         uint64_t rank(uint64_t x) const {
+            if (cardIndex.enabled) {
+                uint64_t result = cardinalityBefore(highBytes(x));
+                auto roaring_destination = roarings.find(highBytes(x));
+                if (roaring_destination != roarings.cend()) {
+                    result += roaring_destination->second.rank(lowBytes(x));
+                }
+                return result;
+            }
             uint64_t result = 0;
             auto roaring_destination = roarings.find(highBytes(x));
             if (roaring_destination != roarings.cend()) {
@@ -1104,6 +1350,11 @@ namespace bluebird {
         int64_t getIndex(uint64_t x) const {
             int64_t index = 0;
             auto roaring_destination = roarings.find(highBytes(x));
+            if (roaring_destination != roarings.cend() && cardIndex.enabled) {
+                auto low_idx = roaring_destination->second.getIndex(lowBytes(x));
+                if (low_idx < 0) return -1;
+                return int64_t(cardinalityBefore(highBytes(x))) + low_idx;
+            }
             if (roaring_destination != roarings.cend()) {
                 for (auto roaring_iter = roarings.cbegin();
                      roaring_iter != roaring_destination; ++roaring_iter) {
@@ -1157,12 +1408,25 @@ namespace bluebird {
          * This function is unsafe in the sense that if you provide bad data, many
          * bytes could be read, possibly causing a buffer overflow. See also
          * readSafe.
+         *
+         * Buffers written by writeIndexed() or writeChecksummed() are
+         * recognized by their cookie.
          */
         static Bitmap64 read(const char *buf, bool portable = true) {
             Bitmap64 result;
             // get map size
             uint64_t map_size;
             std::memcpy(&map_size, buf, sizeof(uint64_t));
+            if (map_size == kIndexedCookie) {
+                uint64_t total;
+                std::memcpy(&total, buf + 2 * sizeof(uint64_t), sizeof(uint64_t));
+                return readIndexed(buf, size_t(total));
+            }
+            if (map_size == kChecksummedCookie) {
+                uint64_t total;
+                std::memcpy(&total, buf + 2 * sizeof(uint64_t), sizeof(uint64_t));
+                return readChecksummed(buf, size_t(total));
+            }
             buf += sizeof(uint64_t);
             for (uint64_t lcv = 0; lcv < map_size; lcv++) {
                 // get map key
@@ -1186,6 +1450,9 @@ namespace bluebird {
          *
          * Setting the portable flag to false enable a custom format that can save
          * space compared to the portable format (e.g., for very sparse bitmaps).
+         *
+         * Buffers written by writeIndexed() or writeChecksummed() are
+         * recognized by their cookie.
          */
         static Bitmap64 readSafe(const char *buf, size_t maxbytes) {
             if (maxbytes < sizeof(uint64_t)) {
@@ -1194,6 +1461,12 @@ namespace bluebird {
             Bitmap64 result;
             uint64_t map_size;
             std::memcpy(&map_size, buf, sizeof(uint64_t));
+            if (map_size == kIndexedCookie) {
+                return readIndexed(buf, maxbytes);
+            }
+            if (map_size == kChecksummedCookie) {
+                return readChecksummed(buf, maxbytes);
+            }
             buf += sizeof(uint64_t);
             maxbytes -= sizeof(uint64_t);
             for (uint64_t lcv = 0; lcv < map_size; lcv++) {
@@ -1237,6 +1510,259 @@ namespace bluebird {
                     });
         }
 
+        /**
+         * Write the bitmap in the indexed format, which a reader can split
+         * between threads without scanning it first. Returns how many bytes
+         * were written, which is getIndexedSizeInBytes().
+         *
+         * The inner bitmaps are cut at container boundaries into pieces of at
+         * most kIndexedChunkContainers containers, each written in the
+         * portable format. The buffer starts with a table giving the key and
+         * the offset of every piece:
+         *
+         *     uint64_t cookie, pieces, total size in bytes
+         *     pieces x { uint32_t key, uint32_t reserved (0), uint64_t offset }
+         *     the pieces, in key order
+         *
+         * Integers are written in the byte order of the machine, as with
+         * write(). The table costs 12 bytes per inner bitmap more than
+         * write(), which matters only for very sparse high keys.
+         */
+        size_t writeIndexed(char *buf) const {
+            return writeIndexed(buf, Bitmap::SerialExecutor());
+        }
+
+        /**
+         * Same as writeIndexed(buf), with the pieces written by
+         * executor.concurrency() tasks. See bluebird/bits/executor.h.
+         */
+        template<typename Executor>
+        size_t writeIndexed(char *buf, Executor &&executor) const {
+            std::vector<IndexedChunk> chunks = indexedChunks();
+            const uint64_t pieces = chunks.size();
+            uint64_t offset = kIndexedHeaderBytes + pieces * kIndexedEntryBytes;
+            for (auto &chunk: chunks) {
+                chunk.offset = offset;
+                offset += chunk.bytes;
+            }
+            const uint64_t total = offset;
+
+            char *out = buf;
+            std::memcpy(out, &kIndexedCookie, sizeof(uint64_t));
+            std::memcpy(out + sizeof(uint64_t), &pieces, sizeof(uint64_t));
+            std::memcpy(out + 2 * sizeof(uint64_t), &total, sizeof(uint64_t));
+            out += kIndexedHeaderBytes;
+            const uint32_t reserved = 0;
+            for (const auto &chunk: chunks) {
+                std::memcpy(out, &chunk.key, sizeof(uint32_t));
+                std::memcpy(out + sizeof(uint32_t), &reserved, sizeof(uint32_t));
+                std::memcpy(out + 2 * sizeof(uint32_t), &chunk.offset, sizeof(uint64_t));
+                out += kIndexedEntryBytes;
+            }
+            executor.run(chunks.size(), [&](size_t k) {
+                const IndexedChunk &chunk = chunks[k];
+                roaring::api::roaring_bitmap_portable_serialize_range(
+                        &chunk.bitmap->roaring, chunk.begin, chunk.end, buf + chunk.offset);
+            });
+            return size_t(total);
+        }
+
+        /**
+         * How many bytes writeIndexed() needs.
+         */
+        size_t getIndexedSizeInBytes() const {
+            size_t total = kIndexedHeaderBytes;
+            for (const auto &chunk: indexedChunks()) {
+                total += kIndexedEntryBytes + chunk.bytes;
+            }
+            return total;
+        }
+
+        /**
+         * Read a bitmap written by writeIndexed(), reading no more than
+         * maxbytes bytes.
+         */
+        static Bitmap64 readIndexed(const char *buf, size_t maxbytes) {
+            return readIndexed(buf, maxbytes, Bitmap::SerialExecutor());
+        }
+
+        /**
+         * Same as readIndexed(buf, maxbytes), with the pieces read by
+         * executor.concurrency() tasks. See bluebird/bits/executor.h.
+         */
+        template<typename Executor>
+        static Bitmap64 readIndexed(const char *buf, size_t maxbytes, Executor &&executor) {
+            if (maxbytes < kIndexedHeaderBytes) {
+                ROARING_TERMINATE("ran out of bytes");
+            }
+            uint64_t cookie, pieces, total;
+            std::memcpy(&cookie, buf, sizeof(uint64_t));
+            std::memcpy(&pieces, buf + sizeof(uint64_t), sizeof(uint64_t));
+            std::memcpy(&total, buf + 2 * sizeof(uint64_t), sizeof(uint64_t));
+            if (cookie != kIndexedCookie) {
+                ROARING_TERMINATE("not an indexed bitmap");
+            }
+            if (total > maxbytes || total < kIndexedHeaderBytes ||
+                pieces > (total - kIndexedHeaderBytes) / kIndexedEntryBytes) {
+                ROARING_TERMINATE("ran out of bytes");
+            }
+
+            // check the table before reading anything it points to
+            std::vector<uint32_t> keys(pieces);
+            std::vector<uint64_t> offsets(pieces + 1);
+            const char *entry = buf + kIndexedHeaderBytes;
+            for (uint64_t k = 0; k < pieces; ++k) {
+                std::memcpy(&keys[k], entry, sizeof(uint32_t));
+                std::memcpy(&offsets[k], entry + 2 * sizeof(uint32_t), sizeof(uint64_t));
+                entry += kIndexedEntryBytes;
+            }
+            offsets[pieces] = total;
+            const uint64_t table_end = kIndexedHeaderBytes + pieces * kIndexedEntryBytes;
+            for (uint64_t k = 0; k < pieces; ++k) {
+                if (offsets[k] < (k == 0 ? table_end : offsets[k - 1]) ||
+                    offsets[k] > offsets[k + 1] || (k > 0 && keys[k] < keys[k - 1])) {
+                    ROARING_TERMINATE("invalid indexed bitmap table");
+                }
+            }
+
+            std::vector<roaring_bitmap_t *> parts(pieces, nullptr);
+            auto release = [&parts]() {
+                for (auto *p: parts) {
+                    if (p != nullptr) roaring::api::roaring_bitmap_free(p);
+                }
+            };
+            try {
+                executor.run(parts.size(), [&](size_t k) {
+                    const size_t bytes = size_t(offsets[k + 1] - offsets[k]);
+                    roaring_bitmap_t *part = roaring::api::roaring_bitmap_portable_deserialize_safe(
+                            buf + offsets[k], bytes);
+                    if (part == nullptr) {
+                        ROARING_TERMINATE("failed to read indexed bitmap piece");
+                    }
+                    parts[k] = part;
+                    if (roaring::api::roaring_bitmap_portable_size_in_bytes(part) != bytes) {
+                        ROARING_TERMINATE("invalid indexed bitmap piece");
+                    }
+                });
+                // the pieces of an inner bitmap must follow each other
+                for (uint64_t k = 1; k < pieces; ++k) {
+                    const auto &prev = parts[k - 1]->high_low_container;
+                    const auto &next = parts[k]->high_low_container;
+                    if (keys[k] == keys[k - 1] && prev.size > 0 && next.size > 0 &&
+                        prev.keys[prev.size - 1] >= next.keys[0]) {
+                        ROARING_TERMINATE("invalid indexed bitmap piece order");
+                    }
+                }
+            } catch (...) {
+                release();
+                throw;
+            }
+
+            Bitmap64 result;
+            for (uint64_t k = 0; k < pieces;) {
+                uint64_t end = k + 1;
+                while (end < pieces && keys[end] == keys[k]) {
+                    ++end;
+                }
+                std::vector<roaring_bitmap_t *> same(parts.begin() + k, parts.begin() + end);
+                std::fill(parts.begin() + k, parts.begin() + end, nullptr);
+                Bitmap inner;
+                try {
+                    inner = Bitmap::concatenate(same, false, "failed memory alloc in readIndexed");
+                } catch (...) {
+                    release();
+                    throw;
+                }
+                if (!inner.isEmpty()) {
+                    result.roarings.emplace_hint(result.roarings.end(), keys[k], std::move(inner));
+                }
+                k = end;
+            }
+            return result;
+        }
+
+        /**
+         * Write the bitmap in the checksummed format, which lets a reader
+         * catch corrupted bytes. Returns how many bytes were written, which
+         * is getChecksummedSizeInBytes().
+         *
+         * Every inner bitmap is written with Bitmap::writeChecksummed(), so
+         * that each container carries a CRC32C of its payload, behind a
+         * table covered by a CRC32C of its own:
+         *
+         *     uint64_t cookie, inner bitmaps, total size in bytes
+         *     uint32_t table checksum, uint32_t reserved (0)
+         *     inner bitmaps x { uint32_t key, uint32_t reserved (0), uint64_t offset }
+         *     the inner bitmaps, in key order
+         *
+         * The table checksum covers the first three fields and the entries.
+         * read() and readSafe() recognize the format and check every
+         * checksum; ChecksummedBitmap64View in
+         * bluebird/bits/checksummed_bitmap.h checks only the containers
+         * actually queried.
+         */
+        size_t writeChecksummed(char *buf) const {
+            const uint64_t count = std::count_if(
+                    roarings.cbegin(), roarings.cend(),
+                    [](const std::pair<const uint32_t, Bitmap> &map_entry) {
+                        return !map_entry.second.isEmpty();
+                    });
+            char *entry = buf + kChecksummedHeaderBytes;
+            uint64_t offset = kChecksummedHeaderBytes + count * kChecksummedEntryBytes;
+            const uint32_t reserved = 0;
+            for (const auto &map_entry: roarings) {
+                if (map_entry.second.isEmpty()) {
+                    continue;
+                }
+                std::memcpy(entry, &map_entry.first, sizeof(uint32_t));
+                std::memcpy(entry + sizeof(uint32_t), &reserved, sizeof(uint32_t));
+                std::memcpy(entry + 2 * sizeof(uint32_t), &offset, sizeof(uint64_t));
+                entry += kChecksummedEntryBytes;
+                offset += map_entry.second.writeChecksummed(buf + offset);
+            }
+            const uint64_t total = offset;
+            std::memcpy(buf, &kChecksummedCookie, sizeof(uint64_t));
+            std::memcpy(buf + sizeof(uint64_t), &count, sizeof(uint64_t));
+            std::memcpy(buf + 2 * sizeof(uint64_t), &total, sizeof(uint64_t));
+            const uint32_t crc = checksummedTableCrc(buf, count);
+            std::memcpy(buf + 3 * sizeof(uint64_t), &crc, sizeof(uint32_t));
+            std::memcpy(buf + 3 * sizeof(uint64_t) + sizeof(uint32_t), &reserved,
+                        sizeof(uint32_t));
+            return size_t(total);
+        }
+
+        /**
+         * How many bytes writeChecksummed() needs.
+         */
+        size_t getChecksummedSizeInBytes() const {
+            size_t total = kChecksummedHeaderBytes;
+            for (const auto &map_entry: roarings) {
+                if (!map_entry.second.isEmpty()) {
+                    total += kChecksummedEntryBytes +
+                             map_entry.second.getChecksummedSizeInBytes();
+                }
+            }
+            return total;
+        }
+
+        /**
+         * Read a bitmap written by writeChecksummed(), reading no more than
+         * maxbytes bytes, after checking every checksum.
+         * This function throws std::runtime_error if the buffer is truncated
+         * or corrupted.
+         */
+        static Bitmap64 readChecksummed(const char *buf, size_t maxbytes) {
+            Bitmap64 result;
+            for (const auto &entry: checksummedTable(buf, maxbytes)) {
+                Bitmap inner = Bitmap::readChecksummed(buf + entry.offset, entry.bytes);
+                if (inner.getChecksummedSizeInBytes() != entry.bytes) {
+                    ROARING_TERMINATE("invalid checksummed inner bitmap");
+                }
+                result.roarings.emplace_hint(result.roarings.end(), entry.key, std::move(inner));
+            }
+            return result;
+        }
+
         static const Bitmap64 frozenView(const char *buf) {
             // size of bitmap buffer and key
             const size_t metadata_size = sizeof(size_t) + sizeof(uint32_t);
@@ -1366,6 +1892,71 @@ namespace bluebird {
             return Bitmap64(*this) ^= o;
         }
 
+        /**
+         * Returns a copy of the bitmap with 'offset' added to every value.
+         * Values that land outside of [0, 2^64) are dropped. Inner bitmaps are
+         * moved whole when 'offset' is a multiple of 2^32; otherwise each one
+         * is split in two with Bitmap::shifted, at container granularity.
+         */
+        Bitmap64 shifted(int64_t offset) const {
+            Bitmap64 ans;
+            ans.copyOnWrite = copyOnWrite;
+            const int64_t high = offset >> 32;
+            const uint32_t low = static_cast<uint32_t>(offset);
+            const int64_t maxKey = (std::numeric_limits<uint32_t>::max)();
+            for (const auto &map_entry: roarings) {
+                const int64_t key = static_cast<int64_t>(map_entry.first) + high;
+                if (low == 0) {
+                    if (key >= 0 && key <= maxKey) {
+                        ans.roarings.emplace_hint(ans.roarings.end(),
+                                                  static_cast<uint32_t>(key),
+                                                  map_entry.second);
+                    }
+                    continue;
+                }
+                // values below 2^32 - low stay under 'key', the others carry
+                // into the next inner bitmap
+                if (key >= 0 && key <= maxKey) {
+                    ans.appendInner(static_cast<uint32_t>(key),
+                                    map_entry.second.shifted(low));
+                }
+                if (key + 1 >= 0 && key + 1 <= maxKey) {
+                    ans.appendInner(static_cast<uint32_t>(key + 1),
+                                    map_entry.second.shifted(
+                                            static_cast<int64_t>(low) - (INT64_C(1) << 32)));
+                }
+            }
+            return ans;
+        }
+
+        /**
+         * Adds 'offset' to every value, dropping the values that land outside
+         * of [0, 2^64). When 'offset' is a multiple of 2^32 the inner bitmaps
+         * are only re-keyed; otherwise the bitmap is replaced with
+         * shifted(offset).
+         */
+        void shift(int64_t offset) {
+            if (offset == 0) {
+                return;
+            }
+            roarings_t moved;
+            if (static_cast<uint32_t>(offset) == 0) {
+                const int64_t high = offset >> 32;
+                const int64_t maxKey = (std::numeric_limits<uint32_t>::max)();
+                for (auto &map_entry: roarings) {
+                    const int64_t key = static_cast<int64_t>(map_entry.first) + high;
+                    if (key >= 0 && key <= maxKey) {
+                        moved.emplace_hint(moved.end(), static_cast<uint32_t>(key),
+                                           std::move(map_entry.second));
+                    }
+                }
+            } else {
+                moved = std::move(shifted(offset).roarings);
+            }
+            roarings.swap(moved);
+            invalidateCardinalityIndex();
+        }
+
         /**
          * Whether or not we apply copy and write.
          */
@@ -1407,6 +1998,30 @@ namespace bluebird {
          */
         bool getCopyOnWrite() const { return copyOnWrite; }
 
+        /**
+         * Whether or not to maintain prefix sums of the inner cardinalities.
+         * With the index, cardinality() is O(1) and rank(), select() and
+         * getIndex() are logarithmic in the number of inner bitmaps instead
+         * of linear. Mutations only mark the high keys they touch, and the
+         * index catches up on the next query; adding a new high key, or a
+         * bulk operation such as a set operator or range removal, rebuilds it
+         * on the next query instead.
+         *
+         * The index is brought up to date from const methods, so a bitmap
+         * with the index enabled must not be queried from several threads
+         * while it has pending updates.
+         */
+        void setCardinalityIndex(bool val) {
+            if (cardIndex.enabled == val) return;
+            cardIndex = CardinalityIndex{};
+            cardIndex.enabled = val;
+        }
+
+        /**
+         * Whether or not the cardinality index is maintained.
+         */
+        bool getCardinalityIndex() const { return cardIndex.enabled; }
+
         /**
          * Computes the logical or (union) between "n" bitmaps (referenced by a
          * pointer).
@@ -1532,10 +2147,194 @@ namespace bluebird {
             return result;
         }
 
+        /**
+         * Builds a bitmap from the n values of 'vals', in any order and with
+         * repeats, on several threads.
+         *
+         * Slices of the input are partitioned by high 32 bits with a parallel
+         * counting and scatter pass that keeps only the low 32 bits. Each inner
+         * bitmap is then built with Bitmap::fromUnsorted: concurrently, one
+         * task per inner bitmap, when there are enough of them, otherwise one
+         * after the other with the whole executor each. The inner bitmaps are
+         * moved into the result in key order.
+         *
+         * See bluebird/bits/executor.h for what an executor must provide.
+         * This function may throw std::runtime_error.
+         */
+        template<typename Executor>
+        static Bitmap64 fromUnsorted(size_t n, const uint64_t *vals, Executor &&executor) {
+            size_t parts = executor.concurrency();
+            if (parts > n / kPartitionMinSlice) {
+                parts = n / kPartitionMinSlice;
+            }
+            if (parts == 0) {
+                parts = 1;
+            }
+            auto slice = [n, parts](size_t p) {
+                return n / parts * p + std::min(p, n % parts);
+            };
+
+            // Count the values of each high key, slice by slice. Ids share few
+            // high keys and mostly come in runs of the same one.
+            std::vector<std::unordered_map<uint32_t, uint64_t>> counts(parts);
+            executor.run(parts, [&](size_t p) {
+                auto &count = counts[p];
+                uint32_t last = 0;
+                uint64_t run = 0;
+                for (size_t i = slice(p); i < slice(p + 1); ++i) {
+                    const uint32_t high = highBytes(vals[i]);
+                    if (run != 0 && high == last) {
+                        ++run;
+                        continue;
+                    }
+                    if (run != 0) {
+                        count[last] += run;
+                    }
+                    last = high;
+                    run = 1;
+                }
+                if (run != 0) {
+                    count[last] += run;
+                }
+            });
+            std::vector<uint32_t> keys;
+            for (const auto &count: counts) {
+                for (const auto &entry: count) {
+                    keys.push_back(entry.first);
+                }
+            }
+            std::sort(keys.begin(), keys.end());
+            keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+            // Slice p writes the low bits of its values of key k after those
+            // of the slices before it.
+            std::vector<uint64_t> starts(keys.size() + 1, 0);
+            uint64_t position = 0;
+            for (size_t k = 0; k < keys.size(); ++k) {
+                starts[k] = position;
+                for (auto &count: counts) {
+                    auto iter = count.find(keys[k]);
+                    if (iter != count.end()) {
+                        const uint64_t c = iter->second;
+                        iter->second = position;
+                        position += c;
+                    }
+                }
+            }
+            starts[keys.size()] = position;
+            std::vector<uint32_t> lows(n);
+            executor.run(parts, [&](size_t p) {
+                auto &next = counts[p];
+                uint32_t last = 0;
+                uint64_t *cursor = nullptr;
+                for (size_t i = slice(p); i < slice(p + 1); ++i) {
+                    const uint32_t high = highBytes(vals[i]);
+                    if (cursor == nullptr || high != last) {
+                        cursor = &next[high];
+                        last = high;
+                    }
+                    lows[(*cursor)++] = lowBytes(vals[i]);
+                }
+            });
+
+            std::vector<Bitmap> inner(keys.size());
+            auto build = [&](size_t k, auto &with) {
+                inner[k] = Bitmap::fromUnsorted(size_t(starts[k + 1] - starts[k]),
+                                                lows.data() + starts[k], with);
+            };
+            if (keys.size() >= executor.concurrency()) {
+                executor.run(keys.size(), [&](size_t k) {
+                    Bitmap::SerialExecutor serial;
+                    build(k, serial);
+                });
+            } else {
+                for (size_t k = 0; k < keys.size(); ++k) {
+                    build(k, executor);
+                }
+            }
+
+            Bitmap64 result;
+            for (size_t k = 0; k < keys.size(); ++k) {
+                result.roarings.emplace_hint(result.roarings.end(), keys[k], std::move(inner[k]));
+            }
+            return result;
+        }
+
+        /**
+         * Merges "n" 32-bit index segments into one 64-bit bitmap: the values
+         * of inputs[i] that are not in deletions[i], plus offsets[i].
+         * 'deletions' and any of its entries may be null. Values that land
+         * outside of [0, 2^64) are dropped.
+         *
+         * A segment lands in at most two inner bitmaps. The pieces are grouped
+         * by inner key and each group is merged with Bitmap::mergeSegments,
+         * moving containers rather than adding values; inputs sorted by offset
+         * are merged in one pass.
+         */
+        static Bitmap64 mergeSegments(size_t n, const Bitmap **inputs, const int64_t *offsets,
+                                      const Bitmap **deletions = nullptr) {
+            // a segment split over two inner bitmaps has its deletions
+            // applied once
+            std::vector<Bitmap> live;
+            live.reserve(n);
+            std::vector<const Bitmap *> sources(inputs, inputs + n);
+            if (deletions != nullptr) {
+                for (size_t i = 0; i < n; ++i) {
+                    if (deletions[i] != nullptr) {
+                        live.push_back(*inputs[i] - *deletions[i]);
+                        sources[i] = &live.back();
+                    }
+                }
+            }
+
+            std::map<uint32_t, std::pair<std::vector<const Bitmap *>, std::vector<int64_t>>> groups;
+            const int64_t maxKey = (std::numeric_limits<uint32_t>::max)();
+            for (size_t i = 0; i < n; ++i) {
+                const Bitmap &source = *sources[i];
+                if (source.isEmpty()) {
+                    continue;
+                }
+                const int64_t high = offsets[i] >> 32;
+                const uint32_t low = static_cast<uint32_t>(offsets[i]);
+                // values below 2^32 - low stay under 'high', the others carry
+                // into the next key
+                if (high >= 0 && high <= maxKey && source.minimum() <= ~low) {
+                    auto &group = groups[static_cast<uint32_t>(high)];
+                    group.first.push_back(&source);
+                    group.second.push_back(low);
+                }
+                if (low != 0 && high + 1 >= 0 && high + 1 <= maxKey && source.maximum() > ~low) {
+                    auto &group = groups[static_cast<uint32_t>(high + 1)];
+                    group.first.push_back(&source);
+                    group.second.push_back(static_cast<int64_t>(low) - (INT64_C(1) << 32));
+                }
+            }
+
+            Bitmap64 result;
+            result.copyOnWrite = n > 0 && inputs[0]->getCopyOnWrite();
+            for (auto &group: groups) {
+                Bitmap merged = Bitmap::mergeSegments(group.second.first.size(),
+                                                      group.second.first.data(),
+                                                      group.second.second.data());
+                if (!merged.isEmpty()) {
+                    merged.setCopyOnWrite(result.copyOnWrite);
+                    result.roarings.emplace_hint(result.roarings.end(), group.first,
+                                                 std::move(merged));
+                }
+            }
+            return result;
+        }
+
         friend class Bitmap64SetBitForwardIterator;
 
         friend class Bitmap64SetBitBiDirectionalIterator;
 
+        friend class Bitmap64Cursor;
+
+        friend class Bitmap64ReverseCursor;
+
+        friend class ChecksummedBitmap64View;
+
         typedef Bitmap64SetBitForwardIterator const_iterator;
         typedef Bitmap64SetBitBiDirectionalIterator const_bidirectional_iterator;
 
@@ -1557,10 +2356,238 @@ namespace bluebird {
         const_iterator end() const;
 
     private:
+        /**
+         * Most containers in a piece of the indexed format: up to 8 MiB of
+         * bitset containers, so that a large inner bitmap is still read by
+         * several tasks.
+         */
+        static constexpr int32_t kIndexedChunkContainers = 1024;
+
+        static constexpr uint64_t kIndexedCookie = UINT64_C(0x5845444E49343642);  // "B64INDEX"
+        static constexpr size_t kIndexedHeaderBytes = 3 * sizeof(uint64_t);
+        static constexpr size_t kIndexedEntryBytes = 2 * sizeof(uint32_t) + sizeof(uint64_t);
+
+        struct IndexedChunk {
+            uint32_t key;
+            const Bitmap *bitmap;
+            int32_t begin;
+            int32_t end;
+            uint64_t bytes;
+            uint64_t offset;
+        };
+
+        /**
+         * The pieces writeIndexed() cuts the bitmap into, with their sizes.
+         */
+        std::vector<IndexedChunk> indexedChunks() const {
+            std::vector<IndexedChunk> chunks;
+            for (const auto &map_entry: roarings) {
+                const roaring_bitmap_t *inner = &map_entry.second.roaring;
+                const int32_t size = inner->high_low_container.size;
+                if (size == 0) {
+                    continue;
+                }
+                for (int32_t begin = 0; begin < size; begin += kIndexedChunkContainers) {
+                    const int32_t end = std::min(size, begin + kIndexedChunkContainers);
+                    chunks.push_back({map_entry.first, &map_entry.second, begin, end,
+                                      roaring::api::roaring_bitmap_portable_size_in_bytes_range(
+                                              inner, begin, end), 0});
+                }
+            }
+            return chunks;
+        }
+
+        static constexpr uint64_t kChecksummedCookie = UINT64_C(0x4D55534B43343642);  // "B64CKSUM"
+        static constexpr size_t kChecksummedHeaderBytes = 4 * sizeof(uint64_t);
+        static constexpr size_t kChecksummedEntryBytes = 2 * sizeof(uint32_t) + sizeof(uint64_t);
+
+        struct ChecksummedEntry {
+            uint32_t key;
+            uint64_t offset;
+            size_t bytes;
+        };
+
+        /**
+         * CRC32C of the first three header fields and of the 'count' entries
+         * of a checksummed buffer.
+         */
+        static uint32_t checksummedTableCrc(const char *buf, uint64_t count) noexcept {
+            const uint32_t crc = roaring::api::roaring_crc32c(0, buf, 3 * sizeof(uint64_t));
+            return roaring::api::roaring_crc32c(crc, buf + kChecksummedHeaderBytes,
+                                                size_t(count) * kChecksummedEntryBytes);
+        }
+
+        /**
+         * The table of a buffer written by writeChecksummed(), checked
+         * against its checksum and the buffer size, with the size of every
+         * inner bitmap. The inner bitmaps themselves are not checked.
+         * This function throws std::runtime_error on a bad table.
+         */
+        static std::vector<ChecksummedEntry> checksummedTable(const char *buf, size_t maxbytes) {
+            if (maxbytes < kChecksummedHeaderBytes) {
+                ROARING_TERMINATE("ran out of bytes");
+            }
+            uint64_t cookie, count, total;
+            uint32_t crc;
+            std::memcpy(&cookie, buf, sizeof(uint64_t));
+            std::memcpy(&count, buf + sizeof(uint64_t), sizeof(uint64_t));
+            std::memcpy(&total, buf + 2 * sizeof(uint64_t), sizeof(uint64_t));
+            std::memcpy(&crc, buf + 3 * sizeof(uint64_t), sizeof(uint32_t));
+            if (cookie != kChecksummedCookie) {
+                ROARING_TERMINATE("not a checksummed bitmap");
+            }
+            if (total > maxbytes || total < kChecksummedHeaderBytes ||
+                count > (total - kChecksummedHeaderBytes) / kChecksummedEntryBytes) {
+                ROARING_TERMINATE("ran out of bytes");
+            }
+            if (checksummedTableCrc(buf, count) != crc) {
+                ROARING_TERMINATE("checksum mismatch in checksummed bitmap table");
+            }
+            std::vector<ChecksummedEntry> entries(count);
+            const char *entry = buf + kChecksummedHeaderBytes;
+            for (auto &e: entries) {
+                std::memcpy(&e.key, entry, sizeof(uint32_t));
+                std::memcpy(&e.offset, entry + 2 * sizeof(uint32_t), sizeof(uint64_t));
+                entry += kChecksummedEntryBytes;
+            }
+            uint64_t end = kChecksummedHeaderBytes + count * kChecksummedEntryBytes;
+            for (uint64_t k = 0; k < count; ++k) {
+                const uint64_t next = k + 1 < count ? entries[k + 1].offset : total;
+                if (entries[k].offset != end || next < end ||
+                    (k > 0 && entries[k].key <= entries[k - 1].key)) {
+                    ROARING_TERMINATE("invalid checksummed bitmap table");
+                }
+                entries[k].bytes = size_t(next - end);
+                end = next;
+            }
+            return entries;
+        }
+
+        /**
+         * Fewest values per task in the parallel partitioning of
+         * fromUnsorted().
+         */
+        static constexpr size_t kPartitionMinSlice = size_t(1) << 16;
+
         typedef std::map<uint32_t, Bitmap> roarings_t;
         roarings_t roarings{}; // The empty constructor silences warnings from pedantic static analyzers.
         bool copyOnWrite{false};
 
+        /**
+         * Prefix sums of the inner cardinalities, see setCardinalityIndex().
+         * 'keys' may still hold keys since erased from 'roarings'; they count
+         * as empty. Every key of 'roarings' is in 'keys' unless 'stale'.
+         */
+        struct CardinalityIndex {
+            bool enabled{false};
+            bool stale{true};               // rebuild from scratch when synced
+            uint64_t total{0};
+            std::vector<uint32_t> keys{};
+            std::vector<uint64_t> counts{};  // cardinality of each key
+            std::vector<uint64_t> tree{};    // Fenwick tree over counts, 1-based
+            std::vector<uint32_t> dirty{};   // keys whose count may have changed
+        };
+        mutable CardinalityIndex cardIndex{};
+
+        /**
+         * Record that the inner bitmap at 'key' is about to be modified or
+         * created. Must be called by every mutation that goes around
+         * lookupOrCreateInner() and eraseIfEmpty().
+         */
+        void touchCardinalityIndex(uint32_t key) {
+            auto &ix = cardIndex;
+            if (!ix.enabled || ix.stale || (!ix.dirty.empty() && ix.dirty.back() == key)) {
+                return;
+            }
+            // A new key shifts every position; past a point, a rebuild is
+            // cheaper than replaying the dirty keys one by one.
+            if (ix.dirty.size() >= ix.keys.size() ||
+                !std::binary_search(ix.keys.cbegin(), ix.keys.cend(), key)) {
+                invalidateCardinalityIndex();
+                return;
+            }
+            ix.dirty.push_back(key);
+        }
+
+        void invalidateCardinalityIndex() {
+            cardIndex.stale = true;
+            cardIndex.dirty.clear();
+        }
+
+        const CardinalityIndex &syncCardinalityIndex() const {
+            auto &ix = cardIndex;
+            if (ix.stale) {
+                ix.keys.clear();
+                ix.counts.clear();
+                ix.total = 0;
+                for (const auto &map_entry: roarings) {
+                    ix.keys.push_back(map_entry.first);
+                    ix.counts.push_back(map_entry.second.cardinality());
+                    ix.total += ix.counts.back();
+                }
+                const size_t n = ix.keys.size();
+                ix.tree.assign(n + 1, 0);
+                for (size_t i = 1; i <= n; ++i) {
+                    ix.tree[i] += ix.counts[i - 1];
+                    size_t parent = i + (i & (~i + 1));
+                    if (parent <= n) {
+                        ix.tree[parent] += ix.tree[i];
+                    }
+                }
+                ix.stale = false;
+            } else {
+                const size_t n = ix.keys.size();
+                for (uint32_t key: ix.dirty) {
+                    size_t pos = std::lower_bound(ix.keys.cbegin(), ix.keys.cend(), key) -
+                                 ix.keys.cbegin();
+                    auto iter = roarings.find(key);
+                    uint64_t count = iter == roarings.cend() ? 0 : iter->second.cardinality();
+                    // unsigned wrap-around makes this work for decreases too
+                    uint64_t delta = count - ix.counts[pos];
+                    ix.counts[pos] = count;
+                    ix.total += delta;
+                    for (size_t i = pos + 1; i <= n; i += i & (~i + 1)) {
+                        ix.tree[i] += delta;
+                    }
+                }
+            }
+            ix.dirty.clear();
+            return ix;
+        }
+
+        /**
+         * Number of values in the inner bitmaps with a key smaller than
+         * 'key', using the cardinality index.
+         */
+        uint64_t cardinalityBefore(uint32_t key) const {
+            const auto &ix = syncCardinalityIndex();
+            size_t pos = std::lower_bound(ix.keys.cbegin(), ix.keys.cend(), key) -
+                         ix.keys.cbegin();
+            uint64_t result = 0;
+            for (size_t i = pos; i > 0; i -= i & (~i + 1)) {
+                result += ix.tree[i];
+            }
+            return result;
+        }
+
+        /**
+         * The first entry of 'map' at or after 'from' whose key is >= high.
+         * Skips through an iteration usually land on a nearby key, so a few
+         * entries are stepped over linearly before falling back to a search
+         * from the root.
+         */
+        static std::map<uint32_t, Bitmap>::const_iterator
+        advanceKey(const std::map<uint32_t, Bitmap> &map,
+                   std::map<uint32_t, Bitmap>::const_iterator from, uint32_t high) {
+            constexpr int kLinearSteps = 4;
+            for (int step = 0; step < kLinearSteps; ++step, ++from) {
+                if (from == map.cend() || from->first >= high) {
+                    return from;
+                }
+            }
+            return map.lower_bound(high);
+        }
+
         static uint32_t highBytes(const uint64_t in) { return uint32_t(in >> 32); }
 
         static uint32_t lowBytes(const uint64_t in) { return uint32_t(in); }
@@ -1573,6 +2600,7 @@ namespace bluebird {
         // this is needed to tolerate gcc's C++11 libstdc++ lacking emplace
         // prior to version 4.8
         void emplaceOrInsert(const uint32_t key, const Bitmap &value) {
+            touchCardinalityIndex(key);
 #if defined(__GLIBCXX__) && __GLIBCXX__ < 20130322
             roarings.insert(std::make_pair(key, value));
 #else
@@ -1581,6 +2609,7 @@ namespace bluebird {
         }
 
         void emplaceOrInsert(const uint32_t key, Bitmap &&value) {
+            touchCardinalityIndex(key);
 #if defined(__GLIBCXX__) && __GLIBCXX__ < 20130322
             roarings.insert(std::make_pair(key, std::move(value)));
 #else
@@ -1594,11 +2623,28 @@ namespace bluebird {
          * to the (already existing or newly created) inner bitmap.
          */
         Bitmap &lookupOrCreateInner(uint32_t key) {
+            touchCardinalityIndex(key);
             auto &bitmap = roarings[key];
             bitmap.setCopyOnWrite(copyOnWrite);
             return bitmap;
         }
 
+        /*
+         * Merge 'bitmap' into the inner bitmap at 'key', which must not be
+         * below the last key. Used while building a bitmap in key order.
+         */
+        void appendInner(uint32_t key, Bitmap &&bitmap) {
+            if (bitmap.isEmpty()) {
+                return;
+            }
+            if (!roarings.empty() && roarings.rbegin()->first == key) {
+                roarings.rbegin()->second |= bitmap;
+                return;
+            }
+            bitmap.setCopyOnWrite(copyOnWrite);
+            roarings.emplace_hint(roarings.end(), key, std::move(bitmap));
+        }
+
         /**
          * Prints the contents of the bitmap to a caller-provided sink function.
          */
@@ -1637,6 +2683,7 @@ namespace bluebird {
             if (start_high > end_high) {
                 ROARING_TERMINATE("Logic error: start_high > end_high");
             }
+            invalidateCardinalityIndex();
             // next_populated_iter points to the first entry in the outer map with
             // key >= start_high, or end().
             auto next_populated_iter = roarings.lower_bound(start_high);
@@ -1678,11 +2725,34 @@ namespace bluebird {
          * this invalidates 'iter'.
          */
         void eraseIfEmpty(roarings_t::iterator iter) {
+            touchCardinalityIndex(iter->first);
             const auto &bitmap = iter->second;
             if (bitmap.isEmpty()) {
                 roarings.erase(iter);
             }
         }
+
+        /**
+         * Batch size of the bulk operations, which stage the low halves of
+         * the values on the stack.
+         */
+        static constexpr size_t kBulkBatchSize = 1024;
+
+        /**
+         * OR the first 'count' bits of 'src', whose remaining bits are zero,
+         * into 'dst' starting at bit 'pos'.
+         */
+        static void orBits(uint64_t *dst, size_t pos, const uint64_t *src, size_t count) {
+            for (size_t j = 0; j * 64 < count; ++j, pos += 64) {
+                const uint64_t word = src[j];
+                const size_t shift = pos % 64;
+                dst[pos / 64] |= word << shift;
+                // the spilled bits are only nonzero when they fall in range
+                if (shift != 0 && (word >> (64 - shift)) != 0) {
+                    dst[pos / 64 + 1] |= word >> (64 - shift);
+                }
+            }
+        }
     };
 
 /**
@@ -1765,6 +2835,33 @@ namespace bluebird {
             return false;
         }
 
+        /**
+         * Move the iterator forward to the first value >= x; unlike move() it
+         * never goes backwards. Within an inner bitmap the search gallops
+         * from the current position, and the outer map is searched from the
+         * current entry, so a sequence of increasing targets (as in an
+         * intersection) costs time logarithmic in the distances skipped.
+         * Returns whether such a value exists.
+         */
+        bool advanceTo(const value_type &x) {
+            if (map_iter == map_end) return false;
+            const uint32_t high = Bitmap64::highBytes(x);
+            if (map_iter->first > high) return true;
+            if (map_iter->first < high) {
+                map_iter = Bitmap64::advanceKey(p, map_iter, high);
+                if (map_iter == map_end) return false;
+                roaring_init_iterator(&map_iter->second.roaring, &i);
+                if (map_iter->first > high && i.has_value) return true;
+            }
+            if (roaring_skip_uint32_iterator_to(&i, Bitmap64::lowBytes(x))) return true;
+            do {
+                map_iter++;
+                if (map_iter == map_end) return false;
+                roaring_init_iterator(&map_iter->second.roaring, &i);
+            } while (!i.has_value);
+            return true;
+        }
+
         bool operator==(const Bitmap64SetBitForwardIterator &o) const {
             if (map_iter == map_end && o.map_iter == o.map_end) return true;
             if (o.map_iter == o.map_end) return false;
@@ -1861,6 +2958,223 @@ namespace bluebird {
         std::map<uint32_t, Bitmap>::const_iterator map_begin;
     };
 
+    /**
+     * Resumable batch reader over the values of a Bitmap64, in increasing
+     * order; see BitmapCursor. Values of each inner bitmap are read in
+     * batches through the 32-bit bulk path and widened with their high bits.
+     *
+     * The bitmap must outlive the cursor and must not be modified while it
+     * is in use.
+     */
+    class Bitmap64Cursor final {
+    public:
+        explicit Bitmap64Cursor(const Bitmap64 &parent)
+                : p(&parent.roarings), map_iter(parent.roarings.cbegin()) {
+            settle(true);
+        }
+
+        /**
+         * Write up to 'max' of the next values to 'out' and return how many
+         * were written; fewer than 'max' only once the bitmap is exhausted.
+         */
+        size_t read(uint64_t *out, size_t max) {
+            uint32_t lows[kBatchSize];
+            size_t total = 0;
+            while (total < max && map_iter != p->cend()) {
+                size_t chunk = max - total < kBatchSize ? max - total : kBatchSize;
+                const uint64_t high = uint64_t(map_iter->first) << 32;
+                size_t n = roaring::api::roaring_read_uint32_iterator(&i, lows, uint32_t(chunk));
+                for (size_t k = 0; k < n; ++k) {
+                    out[total + k] = high | lows[k];
+                }
+                total += n;
+                if (!i.has_value) {
+                    ++map_iter;
+                    settle(true);
+                }
+            }
+            return total;
+        }
+
+        /**
+         * Whether read() has values left to return.
+         */
+        bool hasNext() const { return map_iter != p->cend(); }
+
+        /**
+         * The value the next read() starts with. Requires hasNext().
+         */
+        uint64_t peek() const {
+            return (uint64_t(map_iter->first) << 32) | i.current_value;
+        }
+
+        /**
+         * Reposition the cursor at the first value >= val, which moves it
+         * backwards if val precedes the current position. Returns whether
+         * such a value exists.
+         */
+        bool seek(uint64_t val) {
+            const uint32_t high = uint32_t(val >> 32);
+            map_iter = p->lower_bound(high);
+            if (map_iter == p->cend()) {
+                return false;
+            }
+            roaring::api::roaring_init_iterator(&map_iter->second.roaring, &i);
+            if (map_iter->first == high &&
+                !roaring::api::roaring_move_uint32_iterator_equalorlarger(&i, uint32_t(val))) {
+                ++map_iter;
+                settle(true);
+            } else {
+                settle(false);
+            }
+            return hasNext();
+        }
+
+        /**
+         * Move forward to the first value >= val, galloping from the current
+         * position; unlike seek() it never moves backwards. Returns whether
+         * such a value exists.
+         */
+        bool advanceTo(uint64_t val) {
+            if (map_iter == p->cend()) {
+                return false;
+            }
+            const uint32_t high = uint32_t(val >> 32);
+            if (map_iter->first > high) {
+                return true;
+            }
+            bool fresh = false;
+            if (map_iter->first < high) {
+                map_iter = Bitmap64::advanceKey(*p, map_iter, high);
+                if (map_iter == p->cend()) {
+                    return false;
+                }
+                roaring::api::roaring_init_iterator(&map_iter->second.roaring, &i);
+                if (map_iter->first > high) {
+                    settle(false);
+                    return hasNext();
+                }
+            }
+            if (!roaring::api::roaring_skip_uint32_iterator_to(&i, uint32_t(val))) {
+                ++map_iter;
+                fresh = true;
+            }
+            settle(fresh);
+            return hasNext();
+        }
+
+        /**
+         * Go back to the smallest value.
+         */
+        void rewind() {
+            map_iter = p->cbegin();
+            settle(true);
+        }
+
+    private:
+        static constexpr size_t kBatchSize = 1024;
+
+        /**
+         * Move to the first inner bitmap, from map_iter on, that has values
+         * left. 'fresh' tells whether the inner iterator must first be
+         * initialized on map_iter.
+         */
+        void settle(bool fresh) {
+            for (; map_iter != p->cend(); ++map_iter, fresh = true) {
+                if (fresh) {
+                    roaring::api::roaring_init_iterator(&map_iter->second.roaring, &i);
+                }
+                if (i.has_value) {
+                    return;
+                }
+            }
+        }
+
+        const std::map<uint32_t, Bitmap> *p;
+        std::map<uint32_t, Bitmap>::const_iterator map_iter;
+        roaring::api::roaring_uint32_iterator_t i{};
+    };
+
+    /**
+     * Resumable batch reader over the values of a Bitmap64, in decreasing
+     * order; see BitmapReverseCursor.
+     *
+     * The bitmap must outlive the cursor and must not be modified while it
+     * is in use.
+     */
+    class Bitmap64ReverseCursor final {
+    public:
+        explicit Bitmap64ReverseCursor(const Bitmap64 &parent)
+                : p(&parent.roarings), map_iter(parent.roarings.crbegin()) {
+            settle();
+        }
+
+        /**
+         * Write up to 'max' of the next smaller values to 'out' and return how
+         * many were written; fewer than 'max' only once the bitmap is
+         * exhausted.
+         */
+        size_t read(uint64_t *out, size_t max) {
+            uint32_t lows[kBatchSize];
+            size_t total = 0;
+            while (total < max && map_iter != p->crend()) {
+                size_t chunk = max - total < kBatchSize ? max - total : kBatchSize;
+                const uint64_t high = uint64_t(map_iter->first) << 32;
+                size_t n = roaring::api::roaring_read_previous_uint32_iterator(
+                        &i, lows, uint32_t(chunk));
+                for (size_t k = 0; k < n; ++k) {
+                    out[total + k] = high | lows[k];
+                }
+                total += n;
+                if (!i.has_value) {
+                    ++map_iter;
+                    settle();
+                }
+            }
+            return total;
+        }
+
+        /**
+         * Whether read() has values left to return.
+         */
+        bool hasNext() const { return map_iter != p->crend(); }
+
+        /**
+         * The value the next read() starts with. Requires hasNext().
+         */
+        uint64_t peek() const {
+            return (uint64_t(map_iter->first) << 32) | i.current_value;
+        }
+
+        /**
+         * Go back to the largest value.
+         */
+        void rewind() {
+            map_iter = p->crbegin();
+            settle();
+        }
+
+    private:
+        static constexpr size_t kBatchSize = 1024;
+
+        /**
+         * Move to the first inner bitmap, from map_iter on in decreasing key
+         * order, that has values, and position on its last value.
+         */
+        void settle() {
+            for (; map_iter != p->crend(); ++map_iter) {
+                roaring::api::roaring_init_iterator_last(&map_iter->second.roaring, &i);
+                if (i.has_value) {
+                    return;
+                }
+            }
+        }
+
+        const std::map<uint32_t, Bitmap> *p;
+        std::map<uint32_t, Bitmap>::const_reverse_iterator map_iter;
+        roaring::api::roaring_uint32_iterator_t i{};
+    };
+
     inline Bitmap64SetBitForwardIterator Bitmap64::begin() const {
         return Bitmap64SetBitForwardIterator(*this);
     }
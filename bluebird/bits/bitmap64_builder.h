@@ -0,0 +1,101 @@
+// Copyright 2023 The titan-search Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef BLUEBIRD_BITS_BITMAP64_BUILDER_H_
+#define BLUEBIRD_BITS_BITMAP64_BUILDER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bluebird/bits/bitmap64.h"
+
+namespace bluebird {
+
+    /**
+     * Builds a Bitmap64 from ids given in any order, such as a bulk index
+     * build of a billion ids.
+     *
+     * Bitmap64::addMany finds the inner bitmap of every value and adds it
+     * there one at a time. The builder only collects the values; build()
+     * hands them to Bitmap64::fromUnsorted, which partitions them by high
+     * 32 bits and builds every inner bitmap in one go, on the threads of an
+     * executor when one is given (see bluebird/bits/executor.h).
+     *
+     * The value buffer is kept from one build() to the next.
+     */
+    class Bitmap64Builder {
+    public:
+        /**
+         * Create a builder. With 'runs', build() run-optimizes its result.
+         */
+        explicit Bitmap64Builder(bool runs = true) noexcept : runs(runs) {}
+
+        /**
+         * Add x.
+         */
+        void add(uint64_t x) { values.push_back(x); }
+
+        /**
+         * Add the n values of 'vals', in any order, repeats allowed.
+         */
+        void addMany(size_t n, const uint64_t *vals) {
+            values.insert(values.end(), vals, vals + n);
+        }
+
+        /**
+         * Number of values added since the last build(), repeats included.
+         */
+        size_t size() const noexcept { return values.size(); }
+
+        /**
+         * Make room for n values in total.
+         */
+        void reserve(size_t n) { values.reserve(n); }
+
+        /**
+         * Drop the values added so far, keeping the buffer.
+         */
+        void clear() noexcept { values.clear(); }
+
+        /**
+         * Return the bitmap of the values added since the last build(), and
+         * start over with an empty builder.
+         * This function may throw std::runtime_error.
+         */
+        Bitmap64 build() { return build(Bitmap::SerialExecutor()); }
+
+        /**
+         * Same as build(), with the work split between executor.concurrency()
+         * tasks.
+         */
+        template<typename Executor>
+        Bitmap64 build(Executor &&executor) {
+            Bitmap64 ans = Bitmap64::fromUnsorted(values.size(), values.data(), executor);
+            values.clear();
+            if (runs) {
+                ans.runOptimize();
+            }
+            return ans;
+        }
+
+    private:
+        bool runs;
+        std::vector<uint64_t> values;
+    };
+
+}  // namespace bluebird
+
+#endif  // BLUEBIRD_BITS_BITMAP64_BUILDER_H_
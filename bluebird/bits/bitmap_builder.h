@@ -0,0 +1,136 @@
+// Copyright 2023 The titan-search Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef BLUEBIRD_BITS_BITMAP_BUILDER_H_
+#define BLUEBIRD_BITS_BITMAP_BUILDER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bluebird/bits/bitmap.h"
+
+namespace bluebird {
+
+    /**
+     * Builds a Bitmap from values given in any order, such as a bulk index
+     * build.
+     *
+     * Bitmap::addMany looks up the container of every value that does not
+     * fall in the same container as the previous one, which on random input
+     * means a binary search and an insertion in the middle of an array per
+     * value. The builder only collects the values; build() groups them by
+     * their 16 high bits with a counting (radix) pass and creates each
+     * container in one go, as an array or a bitset depending on its final
+     * cardinality, then turns into run containers those that are smaller that
+     * way.
+     *
+     * The buffers are kept from one build() to the next, so a builder reused
+     * for many bitmaps allocates only while it grows.
+     */
+    class BitmapBuilder {
+    public:
+        /**
+         * Create a builder. With 'runs', build() run-optimizes its result.
+         */
+        explicit BitmapBuilder(bool runs = true) noexcept : runs(runs) {}
+
+        /**
+         * Add x.
+         */
+        void add(uint32_t x) { values.push_back(x); }
+
+        /**
+         * Add the n values of 'vals', in any order, repeats allowed.
+         */
+        void addMany(size_t n, const uint32_t *vals) {
+            values.insert(values.end(), vals, vals + n);
+        }
+
+        /**
+         * Number of values added since the last build(), repeats included.
+         */
+        size_t size() const noexcept { return values.size(); }
+
+        /**
+         * Make room for n values in total.
+         */
+        void reserve(size_t n) { values.reserve(n); }
+
+        /**
+         * Drop the values added so far, keeping the buffers.
+         */
+        void clear() noexcept { values.clear(); }
+
+        /**
+         * Return the bitmap of the values added since the last build(), and
+         * start over with an empty builder.
+         * This function may throw std::runtime_error.
+         */
+        Bitmap build() {
+            const uint32_t *grouped = group();
+            roaring::api::roaring_bitmap_t *r =
+                    roaring::api::roaring_bitmap_of_grouped(values.size(), grouped);
+            values.clear();
+            if (r == NULL) {
+                ROARING_TERMINATE("failed memory alloc in build");
+            }
+            Bitmap ans(r);
+            if (runs) {
+                ans.runOptimize();
+            }
+            return ans;
+        }
+
+    private:
+        /**
+         * The values grouped by high 16 bits in increasing order, in 'values'
+         * or in 'scratch'.
+         */
+        const uint32_t *group() {
+            const size_t keys = size_t(1) << 16;
+            const size_t n = values.size();
+            if (n < keys) {
+                // below one value per counter, sorting is cheaper
+                std::sort(values.begin(), values.end());
+                return values.data();
+            }
+            counts.assign(keys, 0);
+            for (uint32_t v: values) {
+                counts[v >> 16]++;
+            }
+            size_t position = 0;
+            for (auto &count: counts) {
+                const size_t c = count;
+                count = position;
+                position += c;
+            }
+            scratch.resize(n);
+            for (uint32_t v: values) {
+                scratch[counts[v >> 16]++] = v;
+            }
+            return scratch.data();
+        }
+
+        bool runs;
+        std::vector<uint32_t> values;
+        std::vector<uint32_t> scratch;
+        std::vector<size_t> counts;
+    };
+
+}  // namespace bluebird
+
+#endif  // BLUEBIRD_BITS_BITMAP_BUILDER_H_
@@ -0,0 +1,184 @@
+// Copyright 2023 The titan-search Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef BLUEBIRD_BITS_BITMAP_STATS_H_
+#define BLUEBIRD_BITS_BITMAP_STATS_H_
+
+#include <cstdint>
+#include <string>
+
+#include "bluebird/bits/roaring/roaring.h"
+
+namespace bluebird {
+
+    /**
+     * Snapshot of the process-wide counters of the work bitmap operations do
+     * at the container level: how often each pair of container types met in
+     * each kind of operation (e.g. array & bitset versus run & run), how many
+     * containers changed type, how many shared containers were copied on
+     * write, and how much was allocated.
+     *
+     * The counters are compiled in only when the library is built with
+     * CROARING_STATS defined; otherwise enabled() is false and every count is
+     * zero. To measure a piece of work, take a snapshot before and after it
+     * and subtract them:
+     *
+     *     BitmapStats before = BitmapStats::snapshot();
+     *     runQuery();
+     *     std::cout << (BitmapStats::snapshot() - before).toString();
+     */
+    class BitmapStats {
+    public:
+        typedef roaring::api::roaring_stats_op_t Operation;
+        typedef roaring::api::roaring_stats_container_t ContainerType;
+
+        /**
+         * An all-zero snapshot.
+         */
+        BitmapStats() noexcept : stats() {}
+
+        /**
+         * Whether the counters are compiled in.
+         */
+        static bool enabled() noexcept {
+            return roaring::api::roaring_op_stats_enabled();
+        }
+
+        /**
+         * Read the current counters.
+         */
+        static BitmapStats snapshot() noexcept {
+            BitmapStats ans;
+            roaring::api::roaring_op_stats_get(&ans.stats);
+            return ans;
+        }
+
+        /**
+         * Reset the counters to zero, for every thread.
+         */
+        static void reset() noexcept { roaring::api::roaring_op_stats_reset(); }
+
+        /**
+         * Number of container operations 'op' between a container of type
+         * 'left' and one of type 'right'.
+         */
+        uint64_t operations(Operation op, ContainerType left,
+                            ContainerType right) const noexcept {
+            return stats.ops[op][left][right];
+        }
+
+        /**
+         * Number of container operations 'op', whatever the types.
+         */
+        uint64_t operations(Operation op) const noexcept {
+            uint64_t total = 0;
+            for (int left = 0; left < roaring::api::ROARING_STATS_CONTAINER_TYPES; ++left) {
+                for (int right = 0; right < roaring::api::ROARING_STATS_CONTAINER_TYPES; ++right) {
+                    total += stats.ops[op][left][right];
+                }
+            }
+            return total;
+        }
+
+        /**
+         * Number of containers of type 'from' converted to type 'to'.
+         */
+        uint64_t conversions(ContainerType from, ContainerType to) const noexcept {
+            return stats.conversions[from][to];
+        }
+
+        /**
+         * Number of shared (copy-on-write) containers copied before a write.
+         */
+        uint64_t cowCopies() const noexcept { return stats.cow_copies; }
+
+        /**
+         * Number of allocations made through the roaring allocator.
+         */
+        uint64_t allocations() const noexcept { return stats.allocations; }
+
+        /**
+         * Number of bytes requested from the roaring allocator.
+         */
+        uint64_t bytesAllocated() const noexcept { return stats.bytes_allocated; }
+
+        /**
+         * The raw counters.
+         */
+        const roaring::api::roaring_op_stats_t &raw() const noexcept { return stats; }
+
+        /**
+         * The counts accumulated between 'r' and this later snapshot. Counts
+         * reset in between come out wrapped around.
+         */
+        BitmapStats operator-(const BitmapStats &r) const noexcept {
+            BitmapStats ans(*this);
+            for (int op = 0; op < roaring::api::ROARING_STATS_OPS; ++op) {
+                for (int left = 0; left < roaring::api::ROARING_STATS_CONTAINER_TYPES; ++left) {
+                    for (int right = 0; right < roaring::api::ROARING_STATS_CONTAINER_TYPES; ++right) {
+                        ans.stats.ops[op][left][right] -= r.stats.ops[op][left][right];
+                    }
+                }
+            }
+            for (int from = 0; from < roaring::api::ROARING_STATS_CONTAINER_TYPES; ++from) {
+                for (int to = 0; to < roaring::api::ROARING_STATS_CONTAINER_TYPES; ++to) {
+                    ans.stats.conversions[from][to] -= r.stats.conversions[from][to];
+                }
+            }
+            ans.stats.cow_copies -= r.stats.cow_copies;
+            ans.stats.allocations -= r.stats.allocations;
+            ans.stats.bytes_allocated -= r.stats.bytes_allocated;
+            return ans;
+        }
+
+        /**
+         * Print the non-zero counts, one per line, e.g. "and array/bitset: 12".
+         */
+        std::string toString() const {
+            static const char *const op_names[] = {"and", "or", "xor", "andnot"};
+            static const char *const type_names[] = {"bitset", "array", "run"};
+            std::string str;
+            auto line = [&str](const std::string &name, uint64_t count) {
+                if (count != 0) {
+                    str += name + ": " + std::to_string(count) + "\n";
+                }
+            };
+            for (int op = 0; op < roaring::api::ROARING_STATS_OPS; ++op) {
+                for (int left = 0; left < roaring::api::ROARING_STATS_CONTAINER_TYPES; ++left) {
+                    for (int right = 0; right < roaring::api::ROARING_STATS_CONTAINER_TYPES; ++right) {
+                        line(std::string(op_names[op]) + " " + type_names[left] + "/" +
+                             type_names[right], stats.ops[op][left][right]);
+                    }
+                }
+            }
+            for (int from = 0; from < roaring::api::ROARING_STATS_CONTAINER_TYPES; ++from) {
+                for (int to = 0; to < roaring::api::ROARING_STATS_CONTAINER_TYPES; ++to) {
+                    line(std::string("convert ") + type_names[from] + " to " + type_names[to],
+                         stats.conversions[from][to]);
+                }
+            }
+            line("cow copies", stats.cow_copies);
+            line("allocations", stats.allocations);
+            line("bytes allocated", stats.bytes_allocated);
+            return str;
+        }
+
+    private:
+        roaring::api::roaring_op_stats_t stats;
+    };
+
+}  // namespace bluebird
+
+#endif  // BLUEBIRD_BITS_BITMAP_STATS_H_
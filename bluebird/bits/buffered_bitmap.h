@@ -0,0 +1,172 @@
+// Copyright 2023 The titan-search Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef BLUEBIRD_BITS_BUFFERED_BITMAP_H_
+#define BLUEBIRD_BITS_BUFFERED_BITMAP_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "bluebird/bits/bitmap.h"
+
+namespace bluebird {
+
+    /**
+     * A Bitmap taking random single-value updates through a write buffer.
+     *
+     * Adding a value in the middle of an array container shifts the values
+     * after it, so a stream of random adds into containers of a few thousand
+     * values costs a memmove each. Here add() and remove() only append to a
+     * log. Once the log holds 'threshold' entries, or when the bitmap is
+     * read as a whole, the log is sorted, reduced to the last update of each
+     * value, and merged with one union and one difference: every container
+     * touched is rewritten once per batch instead of once per value.
+     *
+     * contains() consults the log without flushing it, newest entry first,
+     * so it costs O(pending()) on top of the bitmap lookup. Every other read
+     * goes through bitmap(), which flushes first. As with Bitmap, concurrent
+     * use needs external synchronization, reads included.
+     */
+    class BufferedBitmap {
+    public:
+        static const size_t kDefaultThreshold = 512;
+
+        /**
+         * Create an empty bitmap flushing its log every 'threshold' updates.
+         */
+        explicit BufferedBitmap(size_t threshold = kDefaultThreshold)
+                : BufferedBitmap(Bitmap(), threshold) {}
+
+        /**
+         * Buffer the updates of 'base'.
+         */
+        explicit BufferedBitmap(Bitmap base, size_t threshold = kDefaultThreshold)
+                : flushed(std::move(base)), limit(threshold == 0 ? 1 : threshold) {
+            log.reserve(limit);
+        }
+
+        /**
+         * Add x.
+         */
+        void add(uint32_t x) { append(x, true); }
+
+        /**
+         * Add the n values of 'vals'.
+         */
+        void addMany(size_t n, const uint32_t *vals) {
+            for (size_t i = 0; i < n; ++i) {
+                append(vals[i], true);
+            }
+        }
+
+        /**
+         * Remove x.
+         */
+        void remove(uint32_t x) { append(x, false); }
+
+        /**
+         * Check whether x is in the bitmap, buffered updates included.
+         */
+        bool contains(uint32_t x) const noexcept {
+            for (size_t i = log.size(); i-- > 0;) {
+                if (log[i].value == x) {
+                    return log[i].add;
+                }
+            }
+            return flushed.contains(x);
+        }
+
+        /**
+         * Number of values in the bitmap. Flushes the log.
+         */
+        uint64_t cardinality() const { return bitmap().cardinality(); }
+
+        /**
+         * Whether the bitmap is empty. Flushes the log.
+         */
+        bool isEmpty() const { return bitmap().isEmpty(); }
+
+        /**
+         * The bitmap with every buffered update applied, for any other
+         * query. The reference is valid until the next update.
+         */
+        const Bitmap &bitmap() const {
+            flush();
+            return flushed;
+        }
+
+        /**
+         * Apply the buffered updates.
+         */
+        void flush() const {
+            if (log.empty()) {
+                return;
+            }
+            // the last update of a value wins, so keep equal values in order
+            std::stable_sort(log.begin(), log.end(),
+                             [](const Entry &a, const Entry &b) {
+                                 return a.value < b.value;
+                             });
+            std::vector<uint32_t> added, removed;
+            for (size_t i = 0; i < log.size(); ++i) {
+                if (i + 1 < log.size() && log[i + 1].value == log[i].value) {
+                    continue;
+                }
+                (log[i].add ? added : removed).push_back(log[i].value);
+            }
+            log.clear();
+            // sorted input takes the append path of every container
+            if (!removed.empty()) {
+                flushed -= Bitmap(removed.size(), removed.data());
+            }
+            if (!added.empty()) {
+                flushed |= Bitmap(added.size(), added.data());
+            }
+        }
+
+        /**
+         * Number of buffered updates.
+         */
+        size_t pending() const noexcept { return log.size(); }
+
+        /**
+         * Number of buffered updates that triggers a flush.
+         */
+        size_t threshold() const noexcept { return limit; }
+
+    private:
+        struct Entry {
+            uint32_t value;
+            bool add;
+        };
+
+        void append(uint32_t x, bool add) {
+            log.push_back(Entry{x, add});
+            if (log.size() >= limit) {
+                flush();
+            }
+        }
+
+        mutable Bitmap flushed;
+        mutable std::vector<Entry> log;
+        size_t limit;
+    };
+
+}  // namespace bluebird
+
+#endif  // BLUEBIRD_BITS_BUFFERED_BITMAP_H_
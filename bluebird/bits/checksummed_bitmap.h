@@ -0,0 +1,214 @@
+// Copyright 2023 The titan-search Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef BLUEBIRD_BITS_CHECKSUMMED_BITMAP_H_
+#define BLUEBIRD_BITS_CHECKSUMMED_BITMAP_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "bluebird/bits/bitmap.h"
+#include "bluebird/bits/bitmap64.h"
+
+namespace bluebird {
+
+    /**
+     * Read-only view of a bitmap written by Bitmap::writeChecksummed(),
+     * queried in place.
+     *
+     * Bitmap::readSafe() checks every checksum of the buffer before
+     * returning. The view checks the header and the container table when it
+     * is created, and the CRC32C of a container only the first time a query
+     * touches it, so that a lookup in a large mapped file pays for the few
+     * containers it reads. A container found corrupted makes the query throw
+     * std::runtime_error.
+     *
+     * The buffer must outlive the view. Queries may run concurrently: two
+     * threads may then both check the same container, which is harmless.
+     */
+    class ChecksummedBitmapView {
+    public:
+        /**
+         * View the bitmap at 'buf', reading no more than maxbytes bytes.
+         * This function throws std::runtime_error if the header or the table
+         * is truncated or corrupted.
+         */
+        ChecksummedBitmapView(const char *buf, size_t maxbytes) {
+            if (!roaring::api::roaring_checksummed_view_init(&view, buf, maxbytes)) {
+                ROARING_TERMINATE("invalid checksummed bitmap");
+            }
+            verified.reset(new std::atomic<bool>[view.size]);
+            for (int32_t i = 0; i < view.size; ++i) {
+                verified[i].store(false, std::memory_order_relaxed);
+            }
+        }
+
+        /**
+         * Check if value x is present, checking its container first if no
+         * query did yet.
+         * This function throws std::runtime_error on a corrupted container.
+         */
+        bool contains(uint32_t x) const {
+            const int32_t i = roaring::api::roaring_checksummed_view_find(&view, uint16_t(x >> 16));
+            if (i < 0) {
+                return false;
+            }
+            check(i);
+            return roaring::api::roaring_checksummed_view_contains(&view, i, uint16_t(x));
+        }
+
+        /**
+         * Number of values, as recorded in the checked table.
+         */
+        uint64_t cardinality() const noexcept { return view.cardinality; }
+
+        /**
+         * Returns true if the bitmap is empty.
+         */
+        bool isEmpty() const noexcept { return view.size == 0; }
+
+        /**
+         * How many bytes of the buffer the bitmap takes.
+         */
+        size_t getSizeInBytes() const noexcept { return view.bytes; }
+
+        /**
+         * Check every container not checked yet.
+         * This function throws std::runtime_error on a corrupted container.
+         */
+        void verify() const {
+            for (int32_t i = 0; i < view.size; ++i) {
+                check(i);
+            }
+        }
+
+        /**
+         * Read the whole bitmap, checking every container.
+         * This function throws std::runtime_error on a corrupted container.
+         */
+        Bitmap toBitmap() const { return Bitmap::readSafe(view.buf, view.bytes); }
+
+    private:
+        void check(int32_t i) const {
+            if (verified[i].load(std::memory_order_acquire)) {
+                return;
+            }
+            if (!roaring::api::roaring_checksummed_view_verify(&view, i)) {
+                ROARING_TERMINATE("checksum mismatch in checksummed bitmap");
+            }
+            verified[i].store(true, std::memory_order_release);
+        }
+
+        roaring::api::roaring_checksummed_view_t view;
+        std::unique_ptr<std::atomic<bool>[]> verified;
+    };
+
+    /**
+     * Read-only view of a bitmap written by Bitmap64::writeChecksummed(),
+     * queried in place like ChecksummedBitmapView: creating it checks the
+     * tables, and each container is checked the first time a query touches
+     * it.
+     */
+    class ChecksummedBitmap64View {
+    public:
+        /**
+         * View the bitmap at 'buf', reading no more than maxbytes bytes.
+         * This function throws std::runtime_error if a table is truncated or
+         * corrupted.
+         */
+        ChecksummedBitmap64View(const char *buf, size_t maxbytes) : buf(buf) {
+            const auto entries = Bitmap64::checksummedTable(buf, maxbytes);
+            bytes = Bitmap64::kChecksummedHeaderBytes +
+                    entries.size() * Bitmap64::kChecksummedEntryBytes;
+            keys.reserve(entries.size());
+            views.reserve(entries.size());
+            for (const auto &entry: entries) {
+                keys.push_back(entry.key);
+                views.emplace_back(buf + entry.offset, entry.bytes);
+                if (views.back().getSizeInBytes() != entry.bytes) {
+                    ROARING_TERMINATE("invalid checksummed inner bitmap");
+                }
+                bytes += entry.bytes;
+            }
+        }
+
+        /**
+         * Check if value x is present, checking its container first if no
+         * query did yet.
+         * This function throws std::runtime_error on a corrupted container.
+         */
+        bool contains(uint64_t x) const {
+            const uint32_t high = uint32_t(x >> 32);
+            auto it = std::lower_bound(keys.begin(), keys.end(), high);
+            if (it == keys.end() || *it != high) {
+                return false;
+            }
+            return views[it - keys.begin()].contains(uint32_t(x));
+        }
+
+        /**
+         * Number of values, as recorded in the checked tables.
+         */
+        uint64_t cardinality() const noexcept {
+            uint64_t card = 0;
+            for (const auto &v: views) {
+                card += v.cardinality();
+            }
+            return card;
+        }
+
+        /**
+         * Returns true if the bitmap is empty.
+         */
+        bool isEmpty() const noexcept {
+            return std::all_of(views.begin(), views.end(),
+                               [](const ChecksummedBitmapView &v) { return v.isEmpty(); });
+        }
+
+        /**
+         * How many bytes of the buffer the bitmap takes.
+         */
+        size_t getSizeInBytes() const noexcept { return bytes; }
+
+        /**
+         * Check every container not checked yet.
+         * This function throws std::runtime_error on a corrupted container.
+         */
+        void verify() const {
+            for (const auto &v: views) {
+                v.verify();
+            }
+        }
+
+        /**
+         * Read the whole bitmap, checking every container.
+         * This function throws std::runtime_error on a corrupted container.
+         */
+        Bitmap64 toBitmap64() const { return Bitmap64::readChecksummed(buf, bytes); }
+
+    private:
+        const char *buf;
+        size_t bytes;
+        std::vector<uint32_t> keys;
+        std::vector<ChecksummedBitmapView> views;
+    };
+
+}  // namespace bluebird
+
+#endif  // BLUEBIRD_BITS_CHECKSUMMED_BITMAP_H_
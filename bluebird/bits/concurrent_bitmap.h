@@ -0,0 +1,174 @@
+// Copyright 2023 The titan-search Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef BLUEBIRD_BITS_CONCURRENT_BITMAP_H_
+#define BLUEBIRD_BITS_CONCURRENT_BITMAP_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "bluebird/bits/bitmap.h"
+
+namespace bluebird {
+
+    /**
+     * A bitmap that any number of reader threads query through immutable
+     * snapshots while writers keep updating it.
+     *
+     * Writers update a private working bitmap, serialized by a mutex, and
+     * make their changes visible with publish(). Publishing copies the
+     * working bitmap with copy-on-write: the new version shares every
+     * container with the working bitmap, so it costs one pointer per
+     * container whatever the cardinality, and the next write to a container
+     * copies only that container. The version is then swapped in atomically.
+     *
+     * Readers call snapshot() and get a version that never changes under
+     * them. A version is freed, together with the containers no newer
+     * version shares, when its last snapshot is released.
+     *
+     * Snapshots are ordinary copy-on-write bitmaps and may be used as inputs
+     * of any operation from several threads at once. They require the
+     * atomic reference counts of the roaring core (CROARING_ATOMIC_IMPL
+     * other than NONE).
+     */
+    class ConcurrentBitmap {
+    public:
+        typedef std::shared_ptr<const Bitmap> Snapshot;
+
+        /**
+         * Create an empty bitmap.
+         */
+        ConcurrentBitmap() : ConcurrentBitmap(Bitmap()) {}
+
+        /**
+         * Create a bitmap holding the values of 'initial', published.
+         */
+        explicit ConcurrentBitmap(Bitmap initial) : working(std::move(initial)) {
+            working.setCopyOnWrite(true);
+            publishLocked();
+        }
+
+        ConcurrentBitmap(const ConcurrentBitmap &) = delete;
+
+        ConcurrentBitmap &operator=(const ConcurrentBitmap &) = delete;
+
+        /**
+         * The latest published version. Thread-safe, and never waits for a
+         * writer.
+         */
+        Snapshot snapshot() const noexcept { return std::atomic_load(&current); }
+
+        /**
+         * The number of versions published so far, the initial one included.
+         */
+        uint64_t version() const noexcept {
+            return published.load(std::memory_order_acquire);
+        }
+
+        /**
+         * Check the latest published version for x. To run several queries
+         * against the same version, take a snapshot() instead.
+         */
+        bool contains(uint32_t x) const noexcept { return snapshot()->contains(x); }
+
+        /**
+         * Cardinality of the latest published version.
+         */
+        uint64_t cardinality() const noexcept { return snapshot()->cardinality(); }
+
+        /**
+         * Add x to the working bitmap. Visible after the next publish().
+         */
+        void add(uint32_t x) {
+            std::lock_guard<std::mutex> lock(writer);
+            working.add(x);
+        }
+
+        /**
+         * Add the n values of 'vals' to the working bitmap.
+         */
+        void addMany(size_t n, const uint32_t *vals) {
+            std::lock_guard<std::mutex> lock(writer);
+            working.addMany(n, vals);
+        }
+
+        /**
+         * Add the values in [min, max) to the working bitmap.
+         */
+        void addRange(uint64_t min, uint64_t max) {
+            std::lock_guard<std::mutex> lock(writer);
+            working.addRange(min, max);
+        }
+
+        /**
+         * Remove x from the working bitmap.
+         */
+        void remove(uint32_t x) {
+            std::lock_guard<std::mutex> lock(writer);
+            working.remove(x);
+        }
+
+        /**
+         * Remove the values in [min, max) from the working bitmap.
+         */
+        void removeRange(uint64_t min, uint64_t max) {
+            std::lock_guard<std::mutex> lock(writer);
+            working.removeRange(min, max);
+        }
+
+        /**
+         * Apply f(Bitmap &) to the working bitmap under the writer lock and
+         * publish the result, so that readers see all of its changes at once.
+         * f must not keep a reference to the bitmap nor turn copy-on-write
+         * off.
+         */
+        template<class F>
+        void update(F &&f) {
+            std::lock_guard<std::mutex> lock(writer);
+            f(working);
+            working.setCopyOnWrite(true);
+            publishLocked();
+        }
+
+        /**
+         * Make the changes written so far visible to snapshot().
+         */
+        void publish() {
+            std::lock_guard<std::mutex> lock(writer);
+            publishLocked();
+        }
+
+    private:
+        void publishLocked() {
+            // the copy shares the containers of the working bitmap, turning
+            // them into shared containers on both sides
+            Snapshot next = std::make_shared<const Bitmap>(working);
+            std::atomic_store(&current, std::move(next));
+            published.fetch_add(1, std::memory_order_release);
+        }
+
+        std::mutex writer;
+        Bitmap working;
+        Snapshot current;
+        std::atomic<uint64_t> published{0};
+    };
+
+}  // namespace bluebird
+
+#endif  // BLUEBIRD_BITS_CONCURRENT_BITMAP_H_
@@ -0,0 +1,230 @@
+// Copyright 2023 The titan-search Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef BLUEBIRD_BITS_CONCURRENT_BITMAP64_H_
+#define BLUEBIRD_BITS_CONCURRENT_BITMAP64_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "bluebird/bits/bitmap64.h"
+
+namespace bluebird {
+
+    /**
+     * A 64-bit bitmap taking concurrent updates from many writer threads.
+     *
+     * Values are spread over a fixed number of shards by a hash of their
+     * container key (the value without its 16 low bits), so that each roaring
+     * container lives in exactly one shard and dense ids written by different
+     * threads still land in different shards. Each shard has its own lock,
+     * an append buffer and a Bitmap64; add() only appends to the buffer, which
+     * is drained into the bitmap with addMany() once it holds 'batchSize'
+     * values, so the lock is held for a few instructions on most calls.
+     *
+     * snapshot() returns a consistent Bitmap64: it holds every shard lock at
+     * once while it takes copy-on-write copies of the shards, which costs one
+     * pointer per container, and merges them after releasing the locks.
+     * Writers pay for this with a copy of each container they modify next.
+     */
+    class ConcurrentBitmap64 {
+    public:
+        static const size_t kDefaultShards = 64;
+        static const size_t kDefaultBatchSize = 1024;
+
+        /**
+         * Create an empty bitmap with 'shards' shards, rounded up to a power
+         * of two, draining the append buffers every 'batchSize' values.
+         */
+        explicit ConcurrentBitmap64(size_t shards = kDefaultShards,
+                                    size_t batchSize = kDefaultBatchSize)
+                : batch(batchSize == 0 ? 1 : batchSize) {
+            size_t n = 1;
+            while (n < shards) {
+                n <<= 1;
+                ++shift;
+            }
+            shift = 64 - shift;
+            parts.reset(new Shard[n]);
+            count = n;
+            for (size_t k = 0; k < count; ++k) {
+                parts[k].pending.reserve(batch);
+                parts[k].bitmap.setCopyOnWrite(true);
+            }
+        }
+
+        ConcurrentBitmap64(const ConcurrentBitmap64 &) = delete;
+
+        ConcurrentBitmap64 &operator=(const ConcurrentBitmap64 &) = delete;
+
+        /**
+         * Add x. Thread-safe.
+         */
+        void add(uint64_t x) {
+            Shard &s = shardOf(x);
+            std::lock_guard<std::mutex> lock(s.mutex);
+            s.pending.push_back(x);
+            if (s.pending.size() >= batch) {
+                s.drain();
+            }
+        }
+
+        /**
+         * Add the n values of 'vals', taking each shard lock once. Thread-safe.
+         */
+        void addMany(size_t n, const uint64_t *vals) {
+            std::vector<std::vector<uint64_t>> split(count);
+            for (size_t i = 0; i < n; ++i) {
+                split[shardIndex(vals[i])].push_back(vals[i]);
+            }
+            for (size_t k = 0; k < count; ++k) {
+                if (split[k].empty()) {
+                    continue;
+                }
+                Shard &s = parts[k];
+                std::lock_guard<std::mutex> lock(s.mutex);
+                s.drain();
+                s.bitmap.addMany(split[k].size(), split[k].data());
+            }
+        }
+
+        /**
+         * Remove x. Values added before are removed too, even if still
+         * buffered. Thread-safe.
+         */
+        void remove(uint64_t x) {
+            Shard &s = shardOf(x);
+            std::lock_guard<std::mutex> lock(s.mutex);
+            s.drain();
+            s.bitmap.remove(x);
+        }
+
+        /**
+         * Check whether x was added. Thread-safe.
+         */
+        bool contains(uint64_t x) {
+            Shard &s = shardOf(x);
+            std::lock_guard<std::mutex> lock(s.mutex);
+            s.drain();
+            return s.bitmap.contains(x);
+        }
+
+        /**
+         * Number of values, summed shard by shard: exact only when no
+         * writer runs concurrently. Thread-safe.
+         */
+        uint64_t cardinality() {
+            uint64_t total = 0;
+            for (size_t k = 0; k < count; ++k) {
+                Shard &s = parts[k];
+                std::lock_guard<std::mutex> lock(s.mutex);
+                s.drain();
+                total += s.bitmap.cardinality();
+            }
+            return total;
+        }
+
+        /**
+         * Drain every append buffer into its bitmap. Thread-safe.
+         */
+        void flush() {
+            for (size_t k = 0; k < count; ++k) {
+                Shard &s = parts[k];
+                std::lock_guard<std::mutex> lock(s.mutex);
+                s.drain();
+            }
+        }
+
+        /**
+         * Run-optimize every shard, e.g. once ingestion is done. Thread-safe.
+         */
+        void runOptimize() {
+            for (size_t k = 0; k < count; ++k) {
+                Shard &s = parts[k];
+                std::lock_guard<std::mutex> lock(s.mutex);
+                s.drain();
+                s.bitmap.runOptimize();
+            }
+        }
+
+        /**
+         * A copy of the values added so far, as of a single point in time:
+         * writes that completed before the call are all in it, and none that
+         * started after it returned. The copy has copy-on-write enabled and
+         * belongs to the caller. Thread-safe.
+         */
+        Bitmap64 snapshot() {
+            std::vector<Bitmap64> copies;
+            copies.reserve(count);
+            {
+                std::vector<std::unique_lock<std::mutex>> locks;
+                locks.reserve(count);
+                for (size_t k = 0; k < count; ++k) {
+                    locks.emplace_back(parts[k].mutex);
+                }
+                for (size_t k = 0; k < count; ++k) {
+                    parts[k].drain();
+                    copies.push_back(parts[k].bitmap);
+                }
+            }
+            Bitmap64 ans;
+            ans.setCopyOnWrite(true);
+            for (const Bitmap64 &copy: copies) {
+                ans |= copy;
+            }
+            return ans;
+        }
+
+        /**
+         * Number of shards.
+         */
+        size_t shards() const noexcept { return count; }
+
+    private:
+        struct alignas(64) Shard {  // no cache line shared between shards
+            void drain() {
+                if (!pending.empty()) {
+                    bitmap.addMany(pending.size(), pending.data());
+                    pending.clear();
+                }
+            }
+
+            std::mutex mutex;
+            std::vector<uint64_t> pending;
+            Bitmap64 bitmap;
+        };
+
+        size_t shardIndex(uint64_t x) const noexcept {
+            if (count == 1) {
+                return 0;
+            }
+            // Fibonacci hashing of the container key
+            return static_cast<size_t>(((x >> 16) * UINT64_C(0x9E3779B97F4A7C15)) >> shift);
+        }
+
+        Shard &shardOf(uint64_t x) noexcept { return parts[shardIndex(x)]; }
+
+        std::unique_ptr<Shard[]> parts;
+        size_t count = 0;
+        unsigned shift = 0;
+        size_t batch;
+    };
+
+}  // namespace bluebird
+
+#endif  // BLUEBIRD_BITS_CONCURRENT_BITMAP64_H_
@@ -0,0 +1,110 @@
+// Copyright 2023 The titan-search Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef BLUEBIRD_BITS_EXECUTOR_H_
+#define BLUEBIRD_BITS_EXECUTOR_H_
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace bluebird {
+
+    /**
+     * The bitmap functions that take an "executor" argument only require two
+     * members from it:
+     *
+     *   size_t concurrency() const;
+     *       How many tasks may usefully run at the same time. The work is
+     *       split into about that many pieces.
+     *
+     *   void run(size_t n, const std::function<void(size_t)> &task);
+     *       Invoke task(0) ... task(n - 1), possibly concurrently, and return
+     *       once all of them have finished. If a task throws, the exception
+     *       should be propagated to the caller after the others completed.
+     *
+     * Any thread pool can be adapted to this interface. ThreadExecutor is a
+     * self-contained implementation that starts plain std::threads per call.
+     */
+    class ThreadExecutor {
+    public:
+        /**
+         * Create an executor running up to 'threads' tasks at a time. Zero
+         * means std::thread::hardware_concurrency().
+         */
+        explicit ThreadExecutor(size_t threads = 0) noexcept
+                : threads(threads != 0 ? threads : std::thread::hardware_concurrency()) {
+            if (this->threads == 0) {
+                this->threads = 1;
+            }
+        }
+
+        size_t concurrency() const noexcept { return threads; }
+
+        /**
+         * Run task(0) ... task(n - 1) on up to concurrency() threads, the
+         * calling thread included. The first exception thrown by a task is
+         * rethrown once every thread has joined.
+         */
+        void run(size_t n, const std::function<void(size_t)> &task) const {
+            if (n == 0) {
+                return;
+            }
+            size_t workers = threads < n ? threads : n;
+            std::atomic<size_t> next{0};
+            std::exception_ptr error;
+            std::mutex error_lock;
+            auto work = [&]() {
+                for (size_t i = next++; i < n; i = next++) {
+                    try {
+                        task(i);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> guard(error_lock);
+                        if (!error) {
+                            error = std::current_exception();
+                        }
+                    }
+                }
+            };
+            std::vector<std::thread> pool;
+            pool.reserve(workers - 1);
+            for (size_t t = 1; t < workers; ++t) {
+                try {
+                    pool.emplace_back(work);
+                } catch (const std::system_error &) {
+                    break;  // the threads already started share the work
+                }
+            }
+            work();
+            for (auto &thread: pool) {
+                thread.join();
+            }
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+
+    private:
+        size_t threads;
+    };
+
+}  // namespace bluebird
+
+#endif  // BLUEBIRD_BITS_EXECUTOR_H_
@@ -0,0 +1,210 @@
+// Copyright 2023 The titan-search Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef BLUEBIRD_BITS_LEAPFROG_JOIN_H_
+#define BLUEBIRD_BITS_LEAPFROG_JOIN_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "bluebird/bits/bitmap.h"
+#include "bluebird/bits/bitmap64.h"
+
+namespace bluebird {
+
+    namespace internal {
+
+        template<class BitmapType>
+        struct LeapfrogTraits;
+
+        template<>
+        struct LeapfrogTraits<Bitmap> {
+            typedef BitmapCursor cursor_type;
+            typedef uint32_t value_type;
+        };
+
+        template<>
+        struct LeapfrogTraits<Bitmap64> {
+            typedef Bitmap64Cursor cursor_type;
+            typedef uint64_t value_type;
+        };
+
+    }  // namespace internal
+
+    /**
+     * Streaming intersection of any number of bitmaps, following the unary
+     * leapfrog join of Veldhuizen's leapfrog triejoin. The inputs are kept in
+     * cyclic order of their current values; the input with the smallest value
+     * is moved with advanceTo() to the largest one, until all of them agree.
+     *
+     * Each input advances by galloping, so the work is bounded by the most
+     * selective inputs: intersecting a huge bitmap with a few small ones
+     * touches only the parts of the huge one near the candidates. Matches are
+     * produced one at a time and the join stops as soon as 'limit' values were
+     * produced, which suits conjunctive queries wanting the first k results.
+     *
+     * The inputs must outlive the join and must not be modified while it is
+     * in use. With no inputs the join is empty.
+     */
+    template<class BitmapType>
+    class BasicLeapfrogJoin final {
+        typedef typename internal::LeapfrogTraits<BitmapType>::cursor_type cursor_type;
+
+    public:
+        typedef typename internal::LeapfrogTraits<BitmapType>::value_type value_type;
+
+        /**
+         * Join the 'n' bitmaps in 'inputs', producing at most 'limit' values.
+         */
+        BasicLeapfrogJoin(size_t n, const BitmapType *const *inputs,
+                          uint64_t limit = std::numeric_limits<uint64_t>::max())
+                : remaining(limit) {
+            cursors.reserve(n);
+            for (size_t k = 0; k < n; ++k) {
+                cursors.emplace_back(*inputs[k]);
+                if (!cursors.back().hasNext()) {
+                    exhausted = true;
+                }
+            }
+            if (n == 0 || limit == 0) {
+                exhausted = true;
+            }
+            if (exhausted) {
+                return;
+            }
+            std::sort(cursors.begin(), cursors.end(),
+                      [](const cursor_type &a, const cursor_type &b) {
+                          return a.peek() < b.peek();
+                      });
+            current = cursors.back().peek();
+            search();
+        }
+
+        /**
+         * Whether there is a match left to produce.
+         */
+        bool hasNext() const { return !exhausted; }
+
+        /**
+         * The match next() returns next. Requires hasNext().
+         */
+        value_type peek() const { return current; }
+
+        /**
+         * Store the next match in 'out' and return true, or return false once
+         * the join is exhausted or the limit was reached.
+         */
+        bool next(value_type &out) {
+            if (exhausted) {
+                return false;
+            }
+            out = current;
+            step();
+            return true;
+        }
+
+        /**
+         * Write up to 'max' of the next matches to 'out' and return how many
+         * were written; fewer than 'max' only once the join is exhausted.
+         */
+        size_t read(value_type *out, size_t max) {
+            size_t total = 0;
+            while (total < max && !exhausted) {
+                out[total++] = current;
+                step();
+            }
+            return total;
+        }
+
+        /**
+         * Skip to the first match >= val; the join never moves backwards.
+         * This is the seek operation an enclosing join level needs. Returns
+         * whether such a match exists.
+         */
+        bool advanceTo(value_type val) {
+            if (exhausted) {
+                return false;
+            }
+            if (val > current) {
+                leapTo(val);
+            }
+            return !exhausted;
+        }
+
+    private:
+        /**
+         * Move the inputs forward until they all sit on the same value, the
+         * next match. On entry every input is positioned and 'current' holds
+         * the largest of their values, which is the value of the input
+         * preceding 'lead' in cyclic order.
+         */
+        void search() {
+            for (;;) {
+                cursor_type &c = cursors[lead];
+                if (c.peek() == current) {
+                    return;  // the smallest value equals the largest one
+                }
+                if (!c.advanceTo(current)) {
+                    exhausted = true;
+                    return;
+                }
+                current = c.peek();
+                lead = lead + 1 == cursors.size() ? 0 : lead + 1;
+            }
+        }
+
+        /**
+         * Move the input with the smallest value to val (> current) and
+         * search for the next match from there.
+         */
+        void leapTo(value_type val) {
+            cursor_type &c = cursors[lead];
+            if (!c.advanceTo(val)) {
+                exhausted = true;
+                return;
+            }
+            current = c.peek();
+            lead = lead + 1 == cursors.size() ? 0 : lead + 1;
+            search();
+        }
+
+        /**
+         * Account for the match just produced and find the following one.
+         */
+        void step() {
+            if (--remaining == 0 ||
+                current == std::numeric_limits<value_type>::max()) {
+                exhausted = true;
+                return;
+            }
+            leapTo(current + 1);
+        }
+
+        std::vector<cursor_type> cursors;
+        size_t lead = 0;
+        value_type current = 0;
+        uint64_t remaining;
+        bool exhausted = false;
+    };
+
+    typedef BasicLeapfrogJoin<Bitmap> LeapfrogJoin;
+    typedef BasicLeapfrogJoin<Bitmap64> LeapfrogJoin64;
+
+}  // namespace bluebird
+
+#endif  // BLUEBIRD_BITS_LEAPFROG_JOIN_H_
@@ -517,6 +517,72 @@ bool array_container_iterate64(const array_container_t *cont, uint32_t base,
     return true;
 }
 
+#if CROARING_IS_X64
+/* Same as the portable loop in array_container_contains_many, except that the
+ * search stops at a window of 16 values which are compared all at once.
+ * Requires a cardinality of at least 16. */
+CROARING_TARGET_AVX2
+static int array_container_contains_many_avx2(const array_container_t *arr,
+                                              const uint32_t *vals, size_t n,
+                                              uint64_t *words, uint64_t bit) {
+    const uint16_t *array = arr->array;
+    const int32_t card = arr->cardinality;
+    const uint16_t *last = array + card - 16;
+    int found = 0;
+    for (size_t i = 0; i < n; i++, bit++) {
+        const uint16_t x = (uint16_t)vals[i];
+        const uint16_t *base = array;
+        int32_t len = card;
+        while (len > 16) {
+            const int32_t half = len >> 1;
+            base = (base[half] <= x) ? base + half : base;
+            len -= half;
+        }
+        // x can only be in base[0, len); widen that to 16 values in bounds
+        base = (base < last) ? base : last;
+        const __m256i window = _mm256_loadu_si256((const __m256i *)base);
+        const __m256i eq = _mm256_cmpeq_epi16(window, _mm256_set1_epi16((short)x));
+        const uint64_t present = (uint64_t)!_mm256_testz_si256(eq, eq);
+        words[bit >> 6] |= present << (bit & 63);
+        found += (int)present;
+    }
+    return found;
+}
+CROARING_UNTARGET_AVX2
+#endif // CROARING_IS_X64
+
+int array_container_contains_many(const array_container_t *arr,
+                                  const uint32_t *vals, size_t n,
+                                  uint64_t *words, uint64_t bit) {
+    const int32_t card = arr->cardinality;
+    if (card == 0) {
+        return 0;
+    }
+#if CROARING_IS_X64
+    if ((card >= 16) && (croaring_hardware_support() & ROARING_SUPPORTS_AVX2)) {
+        return array_container_contains_many_avx2(arr, vals, n, words, bit);
+    }
+#endif
+    const uint16_t *array = arr->array;
+    int found = 0;
+    for (size_t i = 0; i < n; i++, bit++) {
+        const uint16_t x = (uint16_t)vals[i];
+        // the number of steps only depends on the cardinality and the
+        // comparison compiles to a conditional move
+        const uint16_t *base = array;
+        int32_t len = card;
+        while (len > 1) {
+            const int32_t half = len >> 1;
+            base = (base[half] <= x) ? base + half : base;
+            len -= half;
+        }
+        const uint64_t present = (*base == x);
+        words[bit >> 6] |= present << (bit & 63);
+        found += (int)present;
+    }
+    return found;
+}
+
 #ifdef __cplusplus
 } } }  // extern "C" { namespace roaring { namespace internal {
 #endif
@@ -328,6 +328,16 @@ static inline bool array_container_remove(array_container_t *arr,
     return is_present;
 }
 
+/*
+ * Check the 16 least significant bits of each of the n values in vals
+ * against `arr' and set bit (bit + i) of `words' when vals[i] is present;
+ * other bits are left untouched. Returns how many values were present.
+ * No branch depends on the probed values.
+ */
+int array_container_contains_many(const array_container_t *arr,
+                                  const uint32_t *vals, size_t n,
+                                  uint64_t *words, uint64_t bit);
+
 /* Check whether x is present.  */
 inline bool array_container_contains(const array_container_t *arr,
                                      uint16_t pos) {
@@ -1246,6 +1246,20 @@ int bitset_container_index_equalorlarger(const bitset_container_t *container, ui
   return k * 64 + roaring_trailing_zeroes(word);
 }
 
+int bitset_container_contains_many(const bitset_container_t *bitset,
+                                   const uint32_t *vals, size_t n,
+                                   uint64_t *words, uint64_t bit) {
+    const uint64_t *src = bitset->words;
+    int found = 0;
+    for (size_t i = 0; i < n; i++, bit++) {
+        const uint16_t x = (uint16_t)vals[i];
+        const uint64_t present = (src[x >> 6] >> (x & 63)) & 1;
+        words[bit >> 6] |= present << (bit & 63);
+        found += (int)present;
+    }
+    return found;
+}
+
 #ifdef __cplusplus
 } } }  // extern "C" { namespace roaring { namespace internal {
 #endif
@@ -216,6 +216,16 @@ static inline bool bitset_container_get_range(const bitset_container_t *bitset,
     return true;
 }
 
+/*
+ * Check the 16 least significant bits of each of the n values in vals
+ * against `bitset' and set bit (bit + i) of `words' when vals[i] is present;
+ * other bits are left untouched. Returns how many values were present.
+ * No branch depends on the probed values.
+ */
+int bitset_container_contains_many(const bitset_container_t *bitset,
+                                   const uint32_t *vals, size_t n,
+                                   uint64_t *words, uint64_t bit);
+
 /* Check whether `bitset' is present in `array'.  Calls bitset_container_get. */
 inline bool bitset_container_contains(const bitset_container_t *bitset,
                                       uint16_t pos) {
@@ -15,6 +15,7 @@
 
 // The preferences are a separate file to separate out tweakable parameters
 #include "perfparameters.h"
+#include "stats.h"
 
 #ifdef __cplusplus
 namespace roaring { namespace internal {  // No extern "C" (contains template)
@@ -194,12 +194,20 @@ container_t *shared_container_extract_copy(
     assert(sc->typecode != SHARED_CONTAINER_TYPE);
     *typecode = sc->typecode;
     container_t *answer;
-    if (croaring_refcount_dec(&sc->counter)) {
+    // Clone before letting go of our reference: once it is released, another
+    // owner may free the container at any time. A count of one cannot grow
+    // behind our back, since new references are only made from existing ones.
+    if (croaring_refcount_get(&sc->counter) > 1) {
+        answer = container_clone(sc->container, *typecode);
+        roaring_stats_cow_copy();
+        shared_container_free(sc);
+    } else {
+        bool last = croaring_refcount_dec(&sc->counter);
+        assert(last);
+        (void)last;
         answer = sc->container;
         sc->container = NULL;  // paranoid
         roaring_free(sc);
-    } else {
-        answer = container_clone(sc->container, *typecode);
     }
     assert(*typecode != SHARED_CONTAINER_TYPE);
     return answer;
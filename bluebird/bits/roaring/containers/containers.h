@@ -359,6 +359,7 @@ static inline container_t *container_repair_after_lazy(
                 result = array_container_from_bitset(bc);
                 bitset_container_free(bc);
                 *type = ARRAY_CONTAINER_TYPE;
+                roaring_profile_add(ROARING_PROFILE_LAZY_BITSET_TO_ARRAY, 1);
                 return result;
             }
             return c; }
@@ -592,6 +593,33 @@ static inline bool container_contains(
     }
 }
 
+/**
+ * Check the 16 least significant bits of n values against a container and set
+ * bit (bit + i) of words when vals[i] is present. Returns the number found.
+ */
+static inline int container_contains_many(
+    const container_t *c, uint8_t typecode,
+    const uint32_t *vals, size_t n,
+    uint64_t *words, uint64_t bit
+){
+    c = container_unwrap_shared(c, &typecode);
+    switch (typecode) {
+        case BITSET_CONTAINER_TYPE:
+            return bitset_container_contains_many(const_CAST_bitset(c),
+                                                  vals, n, words, bit);
+        case ARRAY_CONTAINER_TYPE:
+            return array_container_contains_many(const_CAST_array(c),
+                                                 vals, n, words, bit);
+        case RUN_CONTAINER_TYPE:
+            return run_container_contains_many(const_CAST_run(c),
+                                               vals, n, words, bit);
+        default:
+            assert(false);
+            roaring_unreachable;
+            return 0;
+    }
+}
+
 /**
  * Check whether a range of values from range_start (included) to range_end (excluded)
  * is in a container, requires a typecode
@@ -743,6 +771,7 @@ static inline container_t *container_and(
     c1 = container_unwrap_shared(c1, &type1);
     c2 = container_unwrap_shared(c2, &type2);
     container_t *result = NULL;
+    roaring_stats_pair(ROARING_STATS_AND, type1, type2);
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET,BITSET):
             *result_type = bitset_bitset_container_intersection(
@@ -832,6 +861,7 @@ static inline int container_and_cardinality(
 ){
     c1 = container_unwrap_shared(c1, &type1);
     c2 = container_unwrap_shared(c2, &type2);
+    roaring_stats_pair(ROARING_STATS_AND, type1, type2);
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET,BITSET):
             return bitset_container_and_justcard(
@@ -885,6 +915,7 @@ static inline bool container_intersect(
 ){
     c1 = container_unwrap_shared(c1, &type1);
     c2 = container_unwrap_shared(c2, &type2);
+    roaring_stats_pair(ROARING_STATS_AND, type1, type2);
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET,BITSET):
             return bitset_container_intersect(const_CAST_bitset(c1),
@@ -946,6 +977,7 @@ static inline container_t *container_iand(
     c1 = get_writable_copy_if_shared(c1, &type1);
     c2 = container_unwrap_shared(c2, &type2);
     container_t *result = NULL;
+    roaring_stats_pair(ROARING_STATS_AND, type1, type2);
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET,BITSET):
             *result_type =
@@ -1040,6 +1072,7 @@ static inline container_t *container_or(
     c1 = container_unwrap_shared(c1, &type1);
     c2 = container_unwrap_shared(c2, &type2);
     container_t *result = NULL;
+    roaring_stats_pair(ROARING_STATS_OR, type1, type2);
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET,BITSET):
             result = bitset_container_create();
@@ -1155,6 +1188,7 @@ static inline container_t *container_lazy_or(
     c1 = container_unwrap_shared(c1, &type1);
     c2 = container_unwrap_shared(c2, &type2);
     container_t *result = NULL;
+    roaring_stats_pair(ROARING_STATS_OR, type1, type2);
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET,BITSET):
             result = bitset_container_create();
@@ -1271,18 +1305,18 @@ static inline container_t *container_ior(
     c1 = get_writable_copy_if_shared(c1, &type1);
     c2 = container_unwrap_shared(c2, &type2);
     container_t *result = NULL;
+    roaring_stats_pair(ROARING_STATS_OR, type1, type2);
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET,BITSET):
             bitset_container_or(const_CAST_bitset(c1),
                                 const_CAST_bitset(c2),
                                 CAST_bitset(c1));
-#ifdef OR_BITSET_CONVERSION_TO_FULL
-            if (CAST_bitset(c1)->cardinality == (1 << 16)) {  // we convert
+            if (roaring_perf_parameters.or_bitset_conversion_to_full &&
+                CAST_bitset(c1)->cardinality == (1 << 16)) {  // we convert
                 result = run_container_create_range(0, (1 << 16));
                 *result_type = RUN_CONTAINER_TYPE;
                 return result;
             }
-#endif
             *result_type = BITSET_CONTAINER_TYPE;
             return c1;
 
@@ -1387,25 +1421,26 @@ static inline container_t *container_lazy_ior(
     // c1 = get_writable_copy_if_shared(c1,&type1);
     c2 = container_unwrap_shared(c2, &type2);
     container_t *result = NULL;
+    roaring_stats_pair(ROARING_STATS_OR, type1, type2);
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET,BITSET):
-#ifdef LAZY_OR_BITSET_CONVERSION_TO_FULL
-            // if we have two bitsets, we might as well compute the cardinality
-            bitset_container_or(const_CAST_bitset(c1),
-                                const_CAST_bitset(c2),
-                                CAST_bitset(c1));
-            // it is possible that two bitsets can lead to a full container
-            if (CAST_bitset(c1)->cardinality == (1 << 16)) {  // we convert
-                result = run_container_create_range(0, (1 << 16));
-                *result_type = RUN_CONTAINER_TYPE;
-                return result;
+            if (roaring_perf_parameters.lazy_or_bitset_conversion_to_full) {
+                // if we have two bitsets, we might as well compute the
+                // cardinality
+                bitset_container_or(const_CAST_bitset(c1),
+                                    const_CAST_bitset(c2),
+                                    CAST_bitset(c1));
+                // it is possible that two bitsets can lead to a full container
+                if (CAST_bitset(c1)->cardinality == (1 << 16)) {  // we convert
+                    result = run_container_create_range(0, (1 << 16));
+                    *result_type = RUN_CONTAINER_TYPE;
+                    return result;
+                }
+            } else {
+                bitset_container_or_nocard(const_CAST_bitset(c1),
+                                           const_CAST_bitset(c2),
+                                           CAST_bitset(c1));
             }
-#else
-            bitset_container_or_nocard(const_CAST_bitset(c1),
-                                       const_CAST_bitset(c2),
-                                       CAST_bitset(c1));
-
-#endif
             *result_type = BITSET_CONTAINER_TYPE;
             return c1;
 
@@ -1510,6 +1545,7 @@ static inline container_t* container_xor(
     c1 = container_unwrap_shared(c1, &type1);
     c2 = container_unwrap_shared(c2, &type2);
     container_t *result = NULL;
+    roaring_stats_pair(ROARING_STATS_XOR, type1, type2);
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET,BITSET):
             *result_type = bitset_bitset_container_xor(
@@ -1637,6 +1673,7 @@ static inline container_t *container_lazy_xor(
     c1 = container_unwrap_shared(c1, &type1);
     c2 = container_unwrap_shared(c2, &type2);
     container_t *result = NULL;
+    roaring_stats_pair(ROARING_STATS_XOR, type1, type2);
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET,BITSET):
             result = bitset_container_create();
@@ -1737,6 +1774,7 @@ static inline container_t *container_ixor(
     c1 = get_writable_copy_if_shared(c1, &type1);
     c2 = container_unwrap_shared(c2, &type2);
     container_t *result = NULL;
+    roaring_stats_pair(ROARING_STATS_XOR, type1, type2);
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET,BITSET):
             *result_type = bitset_bitset_container_ixor(
@@ -1824,6 +1862,7 @@ static inline container_t *container_lazy_ixor(
     assert(type1 != SHARED_CONTAINER_TYPE);
     // c1 = get_writable_copy_if_shared(c1,&type1);
     c2 = container_unwrap_shared(c2, &type2);
+    roaring_stats_pair(ROARING_STATS_XOR, type1, type2);
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET,BITSET):
             bitset_container_xor_nocard(CAST_bitset(c1),
@@ -1860,6 +1899,7 @@ static inline container_t *container_andnot(
     c1 = container_unwrap_shared(c1, &type1);
     c2 = container_unwrap_shared(c2, &type2);
     container_t *result = NULL;
+    roaring_stats_pair(ROARING_STATS_ANDNOT, type1, type2);
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET,BITSET):
             *result_type = bitset_bitset_container_andnot(
@@ -1969,6 +2009,7 @@ static inline container_t *container_iandnot(
     c1 = get_writable_copy_if_shared(c1, &type1);
     c2 = container_unwrap_shared(c2, &type2);
     container_t *result = NULL;
+    roaring_stats_pair(ROARING_STATS_ANDNOT, type1, type2);
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET,BITSET):
             *result_type = bitset_bitset_container_iandnot(
@@ -18,6 +18,7 @@ extern "C" { namespace roaring { namespace internal {
 // file contains grubby stuff that must know impl. details of all container
 // types.
 bitset_container_t *bitset_container_from_array(const array_container_t *ac) {
+    roaring_stats_conversion(ARRAY_CONTAINER_TYPE, BITSET_CONTAINER_TYPE);
     bitset_container_t *ans = bitset_container_create();
     int limit = array_container_cardinality(ac);
     for (int i = 0; i < limit; ++i) bitset_container_set(ans, ac->array[i]);
@@ -25,6 +26,7 @@ bitset_container_t *bitset_container_from_array(const array_container_t *ac) {
 }
 
 bitset_container_t *bitset_container_from_run(const run_container_t *arr) {
+    roaring_stats_conversion(RUN_CONTAINER_TYPE, BITSET_CONTAINER_TYPE);
     int card = run_container_cardinality(arr);
     bitset_container_t *answer = bitset_container_create();
     for (int rlepos = 0; rlepos < arr->n_runs; ++rlepos) {
@@ -36,6 +38,7 @@ bitset_container_t *bitset_container_from_run(const run_container_t *arr) {
 }
 
 array_container_t *array_container_from_run(const run_container_t *arr) {
+    roaring_stats_conversion(RUN_CONTAINER_TYPE, ARRAY_CONTAINER_TYPE);
     array_container_t *answer =
         array_container_create_given_capacity(run_container_cardinality(arr));
     answer->cardinality = 0;
@@ -51,6 +54,7 @@ array_container_t *array_container_from_run(const run_container_t *arr) {
 }
 
 array_container_t *array_container_from_bitset(const bitset_container_t *bits) {
+    roaring_stats_conversion(BITSET_CONTAINER_TYPE, ARRAY_CONTAINER_TYPE);
     array_container_t *result =
         array_container_create_given_capacity(bits->cardinality);
     result->cardinality = bits->cardinality;
@@ -86,6 +90,7 @@ static void add_run(run_container_t *rc, int s, int e) {
 }
 
 run_container_t *run_container_from_array(const array_container_t *c) {
+    roaring_stats_conversion(ARRAY_CONTAINER_TYPE, RUN_CONTAINER_TYPE);
     int32_t n_runs = array_container_number_of_runs(c);
     run_container_t *answer = run_container_create_given_capacity(n_runs);
     int prev = -2;
@@ -131,6 +136,7 @@ container_t *convert_to_bitset_or_array_container(
         }
         assert(card == answer->cardinality);
         *resulttype = ARRAY_CONTAINER_TYPE;
+        roaring_stats_conversion(RUN_CONTAINER_TYPE, ARRAY_CONTAINER_TYPE);
         //run_container_free(r);
         return answer;
     }
@@ -141,6 +147,7 @@ container_t *convert_to_bitset_or_array_container(
     }
     answer->cardinality = card;
     *resulttype = BITSET_CONTAINER_TYPE;
+    roaring_stats_conversion(RUN_CONTAINER_TYPE, BITSET_CONTAINER_TYPE);
     //run_container_free(r);
     return answer;
 }
@@ -184,6 +191,7 @@ container_t *convert_run_to_efficient_container(
             }
         }
         *typecode_after = ARRAY_CONTAINER_TYPE;
+        roaring_stats_conversion(RUN_CONTAINER_TYPE, ARRAY_CONTAINER_TYPE);
         return answer;
     }
 
@@ -197,6 +205,7 @@ container_t *convert_run_to_efficient_container(
     }
     answer->cardinality = card;
     *typecode_after = BITSET_CONTAINER_TYPE;
+    roaring_stats_conversion(RUN_CONTAINER_TYPE, BITSET_CONTAINER_TYPE);
     return answer;
 }
 
@@ -261,6 +270,7 @@ container_t *convert_run_optimize(
         // now prev is the last seen value
         add_run(answer, run_start, prev);
         *typecode_after = RUN_CONTAINER_TYPE;
+        roaring_stats_conversion(ARRAY_CONTAINER_TYPE, RUN_CONTAINER_TYPE);
         array_container_free(c_qua_array);
         return answer;
     } else if (typecode_original ==
@@ -282,6 +292,7 @@ container_t *convert_run_optimize(
         // BitmapContainer bc, int nbrRuns))
         assert(n_runs > 0);  // no empty bitmaps
         run_container_t *answer = run_container_create_given_capacity(n_runs);
+        roaring_stats_conversion(BITSET_CONTAINER_TYPE, RUN_CONTAINER_TYPE);
 
         int long_ctr = 0;
         uint64_t cur_word = c_qua_bitset->words[0];
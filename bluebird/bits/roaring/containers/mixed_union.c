@@ -283,7 +283,8 @@ bool array_array_container_lazy_union(
     // but such one-time conversions at the end may not be overly expensive. We arrived to this design
     // based on extensive benchmarking.
     //
-    if (totalCardinality <= ARRAY_LAZY_LOWERBOUND) {
+    if (totalCardinality <=
+        (int)roaring_perf_parameters.array_lazy_lowerbound) {
         *dst = array_container_create_given_capacity(totalCardinality);
         if (*dst != NULL) {
             array_container_union(src_1, src_2, CAST_array(*dst));
@@ -299,6 +300,7 @@ bool array_array_container_lazy_union(
         bitset_set_list(ourbitset->words, src_1->array, src_1->cardinality);
         bitset_set_list(ourbitset->words, src_2->array, src_2->cardinality);
         ourbitset->cardinality = BITSET_UNKNOWN_CARDINALITY;
+        roaring_profile_add(ROARING_PROFILE_LAZY_ARRAY_TO_BITSET, 1);
     }
     return returnval;
 }
@@ -321,7 +323,8 @@ bool array_array_container_lazy_inplace_union(
     // but such one-time conversions at the end may not be overly expensive. We arrived to this design
     // based on extensive benchmarking.
     //
-    if (totalCardinality <= ARRAY_LAZY_LOWERBOUND) {
+    if (totalCardinality <=
+        (int)roaring_perf_parameters.array_lazy_lowerbound) {
         if(src_1->capacity < totalCardinality) {
           *dst = array_container_create_given_capacity(2  * totalCardinality); // be purposefully generous
           if (*dst != NULL) {
@@ -374,6 +377,7 @@ bool array_array_container_lazy_inplace_union(
         bitset_set_list(ourbitset->words, src_1->array, src_1->cardinality);
         bitset_set_list(ourbitset->words, src_2->array, src_2->cardinality);
         ourbitset->cardinality = BITSET_UNKNOWN_CARDINALITY;
+        roaring_profile_add(ROARING_PROFILE_LAZY_ARRAY_TO_BITSET, 1);
     }
     return returnval;
 }
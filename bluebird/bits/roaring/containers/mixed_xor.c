@@ -243,7 +243,8 @@ bool array_array_container_lazy_xor(
     // For XOR/exclusive union, we simply followed the heuristic used by the unions (see  mixed_union.c).
     // Further tuning is possible.
     //
-    if (totalCardinality <= ARRAY_LAZY_LOWERBOUND) {
+    if (totalCardinality <=
+        (int)roaring_perf_parameters.array_lazy_lowerbound) {
         *dst = array_container_create_given_capacity(totalCardinality);
         if (*dst != NULL)
             array_container_xor(src_1, src_2, CAST_array(*dst));
@@ -255,6 +256,7 @@ bool array_array_container_lazy_xor(
         bitset_container_t *ourbitset = CAST_bitset(*dst);
         bitset_flip_list(ourbitset->words, src_2->array, src_2->cardinality);
         ourbitset->cardinality = BITSET_UNKNOWN_CARDINALITY;
+        roaring_profile_add(ROARING_PROFILE_LAZY_ARRAY_TO_BITSET, 1);
     }
     return returnval;
 }
@@ -0,0 +1,200 @@
+/*
+ * packed.c
+ *
+ */
+
+#include <string.h>
+
+#include "packed.h"
+
+#ifdef __cplusplus
+extern "C" { namespace roaring { namespace internal {
+#endif
+
+/* Bit width of the largest gap of the block, and the gaps themselves. */
+static inline uint32_t packed_gaps(const uint16_t *values, int32_t n,
+                                   int32_t prev, uint32_t *gaps) {
+    uint32_t all = 0;
+    for (int32_t i = 0; i < n; i++) {
+        gaps[i] = (uint32_t)((int32_t)values[i] - prev - 1);
+        prev = values[i];
+        all |= gaps[i];
+    }
+    for (int32_t i = n; i < PACKED_BLOCK_SIZE; i++) {
+        gaps[i] = 0;
+    }
+    return all == 0 ? 0 : 64 - roaring_leading_zeroes(all);
+}
+
+size_t packed_block_size(const uint16_t *values, int32_t n, int32_t prev) {
+    uint32_t all = 0;
+    for (int32_t i = 0; i < n; i++) {
+        all |= (uint32_t)((int32_t)values[i] - prev - 1);
+        prev = values[i];
+    }
+    const uint32_t b = all == 0 ? 0 : 64 - roaring_leading_zeroes(all);
+    return 1 + 16 * b;
+}
+
+size_t packed_encode_block(const uint16_t *values, int32_t n, int32_t prev,
+                           uint8_t *out) {
+    uint32_t gaps[PACKED_BLOCK_SIZE];
+    const uint32_t b = packed_gaps(values, n, prev, gaps);
+    out[0] = (uint8_t)b;
+    uint8_t *words = out + 1;
+    for (int lane = 0; lane < 4; lane++) {
+        uint64_t acc = 0;
+        uint32_t filled = 0;
+        uint32_t w = 0;
+        for (int i = lane; i < PACKED_BLOCK_SIZE; i += 4) {
+            acc |= (uint64_t)gaps[i] << filled;
+            filled += b;
+            if (filled >= 32) {
+                uint32_t word = (uint32_t)acc;
+                memcpy(words + 16 * w + 4 * lane, &word, sizeof(word));
+                w++;
+                acc >>= 32;
+                filled -= 32;
+            }
+        }
+    }
+    return 1 + 16 * b;
+}
+
+#if CROARING_IS_X64
+/* Unpack the b-bit gaps of a block, four lanes at a time (SSE2). */
+static inline void packed_unpack(const uint8_t *in, uint32_t b,
+                                 uint32_t *gaps) {
+    const __m128i mask = _mm_set1_epi32((int)((UINT32_C(1) << b) - 1));
+    const __m128i *src = (const __m128i *)in;
+    __m128i w = _mm_loadu_si128(src++);
+    uint32_t shift = 0;
+    for (int p = 0; p < PACKED_BLOCK_SIZE / 4; p++) {
+        __m128i v = _mm_srl_epi32(w, _mm_cvtsi32_si128((int)shift));
+        shift += b;
+        if (shift >= 32 && p + 1 < PACKED_BLOCK_SIZE / 4) {
+            shift -= 32;
+            w = _mm_loadu_si128(src++);
+            if (shift > 0) {  // the gap straddles two words
+                v = _mm_or_si128(
+                    v, _mm_sll_epi32(w, _mm_cvtsi32_si128((int)(b - shift))));
+            }
+        }
+        _mm_storeu_si128((__m128i *)(gaps + 4 * p), _mm_and_si128(v, mask));
+    }
+}
+
+/* Turn the gaps into values following prev, four at a time. */
+static inline void packed_prefix_sum(uint32_t *gaps, int32_t prev) {
+    const __m128i one = _mm_set1_epi32(1);
+    __m128i running = _mm_set1_epi32(prev);
+    for (int i = 0; i < PACKED_BLOCK_SIZE; i += 4) {
+        __m128i x = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(gaps + i)), one);
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi32(x, running);
+        _mm_storeu_si128((__m128i *)(gaps + i), x);
+        running = _mm_shuffle_epi32(x, 0xFF);
+    }
+}
+#else
+static inline void packed_unpack(const uint8_t *in, uint32_t b,
+                                 uint32_t *gaps) {
+    const uint32_t mask = (UINT32_C(1) << b) - 1;
+    for (int lane = 0; lane < 4; lane++) {
+        uint64_t acc = 0;
+        uint32_t available = 0;
+        uint32_t w = 0;
+        for (int i = lane; i < PACKED_BLOCK_SIZE; i += 4) {
+            if (available < b) {
+                uint32_t word;
+                memcpy(&word, in + 16 * w + 4 * lane, sizeof(word));
+                w++;
+                acc |= (uint64_t)word << available;
+                available += 32;
+            }
+            gaps[i] = (uint32_t)acc & mask;
+            acc >>= b;
+            available -= b;
+        }
+    }
+}
+
+static inline void packed_prefix_sum(uint32_t *gaps, int32_t prev) {
+    uint32_t running = (uint32_t)prev;
+    for (int i = 0; i < PACKED_BLOCK_SIZE; i++) {
+        running += gaps[i] + 1;
+        gaps[i] = running;
+    }
+}
+#endif
+
+size_t packed_decode_block(const uint8_t *in, size_t maxbytes, int32_t n,
+                           int32_t prev, uint16_t *out) {
+    if (maxbytes < 1) {
+        return 0;
+    }
+    const uint32_t b = in[0];
+    // gaps below 65536 never need more than 16 bits
+    if (b > 16 || maxbytes < 1 + 16 * (size_t)b) {
+        return 0;
+    }
+    uint32_t values[PACKED_BLOCK_SIZE];
+    if (b == 0) {
+        memset(values, 0, sizeof(values));
+    } else {
+        packed_unpack(in + 1, b, values);
+    }
+    packed_prefix_sum(values, prev);
+    // values increase, and no block adds enough to wrap around
+    if (values[n - 1] > UINT16_MAX) {
+        return 0;
+    }
+    for (int32_t i = 0; i < n; i++) {
+        out[i] = (uint16_t)values[i];
+    }
+    return 1 + 16 * b;
+}
+
+size_t packed_encoded_size(const uint16_t *values, int32_t card) {
+    size_t bytes = 0;
+    int32_t prev = -1;
+    for (int32_t i = 0; i < card; i += PACKED_BLOCK_SIZE) {
+        int32_t n = card - i < PACKED_BLOCK_SIZE ? card - i : PACKED_BLOCK_SIZE;
+        bytes += packed_block_size(values + i, n, prev);
+        prev = values[i + n - 1];
+    }
+    return bytes;
+}
+
+size_t packed_encode(const uint16_t *values, int32_t card, uint8_t *out) {
+    size_t bytes = 0;
+    int32_t prev = -1;
+    for (int32_t i = 0; i < card; i += PACKED_BLOCK_SIZE) {
+        int32_t n = card - i < PACKED_BLOCK_SIZE ? card - i : PACKED_BLOCK_SIZE;
+        bytes += packed_encode_block(values + i, n, prev, out + bytes);
+        prev = values[i + n - 1];
+    }
+    return bytes;
+}
+
+size_t packed_decode(const uint8_t *in, size_t maxbytes, int32_t card,
+                     uint16_t *out) {
+    size_t bytes = 0;
+    int32_t prev = -1;
+    for (int32_t i = 0; i < card; i += PACKED_BLOCK_SIZE) {
+        int32_t n = card - i < PACKED_BLOCK_SIZE ? card - i : PACKED_BLOCK_SIZE;
+        size_t used = packed_decode_block(in + bytes, maxbytes - bytes, n, prev,
+                                          out + i);
+        if (used == 0) {
+            return 0;
+        }
+        bytes += used;
+        prev = out[i + n - 1];
+    }
+    return bytes;
+}
+
+#ifdef __cplusplus
+} } }  // extern "C" { namespace roaring { namespace internal {
+#endif
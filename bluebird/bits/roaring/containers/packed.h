@@ -0,0 +1,63 @@
+/*
+ * packed.h
+ *
+ */
+
+#ifndef INCLUDE_CONTAINERS_PACKED_H_
+#define INCLUDE_CONTAINERS_PACKED_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bluebird/bits/roaring/portability.h"
+
+#ifdef __cplusplus
+extern "C" { namespace roaring { namespace internal {
+#endif
+
+/*
+ * Delta bitpacking of sorted 16-bit values, after SIMD-BP128 (Lemire and
+ * Boytsov, "Decoding billions of integers per second through vectorization").
+ *
+ * A value is coded as its gap to the previous value minus one, the first one
+ * relative to `prev` (-1 at the start of a container), so that consecutive
+ * values cost nothing. Gaps are grouped in blocks of PACKED_BLOCK_SIZE. A
+ * block starts with one byte holding the bit width b of its largest gap and
+ * is followed by b 128-bit words; gap i of the block is stored in 32-bit lane
+ * i % 4, so that the four lanes are unpacked at once by SIMD shifts. A last,
+ * partial block is padded with zero gaps.
+ *
+ * A 4096-value array container with gaps below 16 takes about 2 KB instead
+ * of 8 KB. The format is meant for serialization: containers are decoded
+ * before use.
+ */
+enum { PACKED_BLOCK_SIZE = 128 };
+
+/* Number of bytes of the block coding the n (at most PACKED_BLOCK_SIZE)
+ * sorted values following prev. */
+size_t packed_block_size(const uint16_t *values, int32_t n, int32_t prev);
+
+/* Code the n (at most PACKED_BLOCK_SIZE) sorted values following prev to out
+ * and return the number of bytes written, packed_block_size(). */
+size_t packed_encode_block(const uint16_t *values, int32_t n, int32_t prev,
+                           uint8_t *out);
+
+/* Decode the block at in, holding n values following prev, to out. Reads no
+ * more than maxbytes bytes and returns how many were consumed, or 0 if the
+ * block is truncated or does not hold valid 16-bit values. */
+size_t packed_decode_block(const uint8_t *in, size_t maxbytes, int32_t n,
+                           int32_t prev, uint16_t *out);
+
+/* Same as the block functions for a whole container of card sorted values. */
+size_t packed_encoded_size(const uint16_t *values, int32_t card);
+
+size_t packed_encode(const uint16_t *values, int32_t card, uint8_t *out);
+
+size_t packed_decode(const uint8_t *in, size_t maxbytes, int32_t card,
+                     uint16_t *out);
+
+#ifdef __cplusplus
+} } }  // extern "C" { namespace roaring { namespace internal {
+#endif
+
+#endif /* INCLUDE_CONTAINERS_PACKED_H_ */
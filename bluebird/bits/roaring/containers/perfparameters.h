@@ -3,14 +3,23 @@
 
 #include <stdbool.h>
 
+#include "bluebird/bits/roaring/portability.h"
+#include "bluebird/bits/roaring/roaring_types.h"
+
 #ifdef __cplusplus
-extern "C" { namespace roaring { namespace internal {
+extern "C" { namespace roaring {
+
+// Note: in pure C++ code, you should avoid putting `using` in header files
+using api::roaring_perf_parameters_t;
+
+namespace internal {
 #endif
 
 /**
 During lazy computations, we can transform array containers into bitset
 containers as
 long as we can expect them to have  ARRAY_LAZY_LOWERBOUND values.
+This is the default of roaring_perf_parameters.array_lazy_lowerbound.
 */
 enum { ARRAY_LAZY_LOWERBOUND = 1024 };
 
@@ -38,6 +47,35 @@ enum { ARRAY_DEFAULT_INIT_SIZE = 0 };
 #define OR_BITSET_CONVERSION_TO_FULL true
 #endif
 
+/* dense run containers with more runs than these become bitsets for
+ * membership-heavy and union-heavy workloads, see
+ * roaring_bitmap_run_optimize_for() */
+enum { MEMBERSHIP_MAX_RUNS = 32 };
+enum { UNION_MAX_RUNS = 512 };
+
+/* The thresholds above as tuned at runtime (roaring_perf.c). Containers read
+ * them on every operation, so they are meant to be set at startup. */
+extern roaring_perf_parameters_t roaring_perf_parameters;
+
+enum {
+    ROARING_PROFILE_CONTAINS = 0,
+    ROARING_PROFILE_UPDATES,
+    ROARING_PROFILE_UNIONS,
+    ROARING_PROFILE_INTERSECTIONS,
+    ROARING_PROFILE_LAZY_ARRAY_TO_BITSET,
+    ROARING_PROFILE_LAZY_BITSET_TO_ARRAY,
+    ROARING_PROFILE_COUNTERS
+};
+
+extern croaring_counter_t roaring_profile_counters[ROARING_PROFILE_COUNTERS];
+
+/* Count n events of the given kind if profiling is on. */
+static inline void roaring_profile_add(int counter, uint64_t n) {
+    if (roaring_perf_parameters.profile) {
+        croaring_counter_add(&roaring_profile_counters[counter], n);
+    }
+}
+
 #ifdef __cplusplus
 } } }  // extern "C" { namespace roaring { namespace internal {
 #endif
@@ -980,6 +980,34 @@ int run_container_cardinality(const run_container_t *run) {
 #endif
 
 
+int run_container_contains_many(const run_container_t *run,
+                                const uint32_t *vals, size_t n,
+                                uint64_t *words, uint64_t bit) {
+    const int32_t n_runs = run->n_runs;
+    if (n_runs == 0) {
+        return 0;
+    }
+    const rle16_t *runs = run->runs;
+    int found = 0;
+    for (size_t i = 0; i < n; i++, bit++) {
+        const uint16_t x = (uint16_t)vals[i];
+        // find the last run starting at or before x, without branching on x
+        const rle16_t *base = runs;
+        int32_t len = n_runs;
+        while (len > 1) {
+            const int32_t half = len >> 1;
+            base = (base[half].value <= x) ? base + half : base;
+            len -= half;
+        }
+        // wraps around to a large value when x precedes the first run
+        const uint32_t offset = (uint32_t)((int32_t)x - (int32_t)base->value);
+        const uint64_t present = (offset <= base->length);
+        words[bit >> 6] |= present << (bit & 63);
+        found += (int)present;
+    }
+    return found;
+}
+
 #ifdef __cplusplus
 } } }  // extern "C" { namespace roaring { namespace internal {
 #endif
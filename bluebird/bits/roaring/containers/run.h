@@ -245,6 +245,16 @@ static inline bool run_container_remove(run_container_t *run, uint16_t pos) {
     return false;
 }
 
+/*
+ * Check the 16 least significant bits of each of the n values in vals
+ * against `run' and set bit (bit + i) of `words' when vals[i] is present;
+ * other bits are left untouched. Returns how many values were present.
+ * No branch depends on the probed values.
+ */
+int run_container_contains_many(const run_container_t *run,
+                                const uint32_t *vals, size_t n,
+                                uint64_t *words, uint64_t bit);
+
 /* Check whether `pos' is present in `run'.  */
 inline bool run_container_contains(const run_container_t *run, uint16_t pos) {
     int32_t index = interleavedBinarySearch(run->runs, run->n_runs, pos);
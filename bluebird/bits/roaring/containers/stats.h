@@ -0,0 +1,90 @@
+/*
+ * stats.h
+ *
+ * Counters of the container-level work done by bitmap operations, compiled in
+ * only when CROARING_STATS is defined. Without it every hook below is an empty
+ * inline function and costs nothing.
+ */
+
+#ifndef INCLUDE_CONTAINERS_STATS_H_
+#define INCLUDE_CONTAINERS_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bluebird/bits/roaring/portability.h"
+#include "bluebird/bits/roaring/roaring_types.h"
+
+#ifdef __cplusplus
+extern "C" { namespace roaring {
+
+// Note: in pure C++ code, you should avoid putting `using` in header files
+using api::ROARING_STATS_AND;
+using api::ROARING_STATS_OR;
+using api::ROARING_STATS_XOR;
+using api::ROARING_STATS_ANDNOT;
+using api::ROARING_STATS_OPS;
+using api::ROARING_STATS_CONTAINER_TYPES;
+
+namespace internal {
+#endif
+
+#ifdef CROARING_STATS
+
+/* Indexed by operation and by container typecode - 1. Defined in
+ * roaring_perf.c. */
+extern croaring_counter_t
+    roaring_stats_ops[ROARING_STATS_OPS][ROARING_STATS_CONTAINER_TYPES]
+                     [ROARING_STATS_CONTAINER_TYPES];
+extern croaring_counter_t
+    roaring_stats_conversions[ROARING_STATS_CONTAINER_TYPES]
+                             [ROARING_STATS_CONTAINER_TYPES];
+extern croaring_counter_t roaring_stats_cow_copies;
+extern croaring_counter_t roaring_stats_allocations;
+extern croaring_counter_t roaring_stats_bytes_allocated;
+
+/* Count a binary operation on unshared containers of types type1 and type2. */
+static inline void roaring_stats_pair(int op, uint8_t type1, uint8_t type2) {
+    croaring_counter_add(&roaring_stats_ops[op][type1 - 1][type2 - 1], 1);
+}
+
+/* Count the conversion of a container of type from to one of type to. */
+static inline void roaring_stats_conversion(uint8_t from, uint8_t to) {
+    croaring_counter_add(&roaring_stats_conversions[from - 1][to - 1], 1);
+}
+
+/* Count a copy of a shared container made before writing to it. */
+static inline void roaring_stats_cow_copy(void) {
+    croaring_counter_add(&roaring_stats_cow_copies, 1);
+}
+
+/* Count an allocation of the given number of bytes. */
+static inline void roaring_stats_allocation(size_t bytes) {
+    croaring_counter_add(&roaring_stats_allocations, 1);
+    croaring_counter_add(&roaring_stats_bytes_allocated, bytes);
+}
+
+#else
+
+static inline void roaring_stats_pair(int op, uint8_t type1, uint8_t type2) {
+    (void)op;
+    (void)type1;
+    (void)type2;
+}
+
+static inline void roaring_stats_conversion(uint8_t from, uint8_t to) {
+    (void)from;
+    (void)to;
+}
+
+static inline void roaring_stats_cow_copy(void) {}
+
+static inline void roaring_stats_allocation(size_t bytes) { (void)bytes; }
+
+#endif  // CROARING_STATS
+
+#ifdef __cplusplus
+} } }  // extern "C" { namespace roaring { namespace internal {
+#endif
+
+#endif /* INCLUDE_CONTAINERS_STATS_H_ */
@@ -1,6 +1,12 @@
 #include "memory.h"
 #include <stdlib.h>
 
+#include "bluebird/bits/roaring/containers/stats.h"
+
+#ifdef __cplusplus
+using namespace ::roaring::internal;
+#endif
+
 // without the following, we get lots of warnings about posix_memalign
 #ifndef __cplusplus
 extern int posix_memalign(void **__memptr, size_t __alignment, size_t __size);
@@ -45,14 +51,17 @@ void roaring_init_memory_hook(roaring_memory_t memory_hook) {
 }
 
 void* roaring_malloc(size_t n) {
+    roaring_stats_allocation(n);
     return global_memory_hook.malloc(n);
 }
 
 void* roaring_realloc(void* p, size_t new_sz) {
+    roaring_stats_allocation(new_sz);
     return global_memory_hook.realloc(p, new_sz);
 }
 
 void* roaring_calloc(size_t n_elements, size_t element_size) {
+    roaring_stats_allocation(n_elements * element_size);
     return global_memory_hook.calloc(n_elements, element_size);
 }
 
@@ -61,6 +70,7 @@ void roaring_free(void* p) {
 }
 
 void* roaring_aligned_malloc(size_t alignment, size_t size) {
+    roaring_stats_allocation(size);
     return global_memory_hook.aligned_malloc(alignment, size);
 }
 
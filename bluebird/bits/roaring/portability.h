@@ -527,6 +527,70 @@ static inline uint32_t croaring_refcount_get(croaring_refcount_t *val) {
 #error "Unknown atomic implementation"
 #endif
 
+// 64-bit event counters: updates need no ordering, only atomicity, so that
+// counts from concurrent readers of shared bitmaps are not lost.
+#if CROARING_ATOMIC_IMPL == CROARING_ATOMIC_IMPL_C
+typedef _Atomic(uint64_t) croaring_counter_t;
+
+static inline void croaring_counter_add(croaring_counter_t *val, uint64_t n) {
+    atomic_fetch_add_explicit(val, n, memory_order_relaxed);
+}
+
+static inline uint64_t croaring_counter_get(croaring_counter_t *val) {
+    return atomic_load_explicit(val, memory_order_relaxed);
+}
+
+static inline void croaring_counter_reset(croaring_counter_t *val) {
+    atomic_store_explicit(val, 0, memory_order_relaxed);
+}
+#elif CROARING_ATOMIC_IMPL == CROARING_ATOMIC_IMPL_CPP
+typedef std::atomic<uint64_t> croaring_counter_t;
+
+static inline void croaring_counter_add(croaring_counter_t *val, uint64_t n) {
+    val->fetch_add(n, std::memory_order_relaxed);
+}
+
+static inline uint64_t croaring_counter_get(croaring_counter_t *val) {
+    return val->load(std::memory_order_relaxed);
+}
+
+static inline void croaring_counter_reset(croaring_counter_t *val) {
+    val->store(0, std::memory_order_relaxed);
+}
+#elif CROARING_ATOMIC_IMPL == CROARING_ATOMIC_IMPL_C_WINDOWS
+#pragma intrinsic(_InterlockedExchangeAdd64)
+#pragma intrinsic(_InterlockedCompareExchange64)
+#pragma intrinsic(_InterlockedExchange64)
+typedef volatile __int64 croaring_counter_t;
+
+static inline void croaring_counter_add(croaring_counter_t *val, uint64_t n) {
+    _InterlockedExchangeAdd64(val, (__int64)n);
+}
+
+static inline uint64_t croaring_counter_get(croaring_counter_t *val) {
+    // 64-bit reads are not atomic on 32-bit targets
+    return (uint64_t)_InterlockedCompareExchange64(val, 0, 0);
+}
+
+static inline void croaring_counter_reset(croaring_counter_t *val) {
+    _InterlockedExchange64(val, 0);
+}
+#else
+typedef uint64_t croaring_counter_t;
+
+static inline void croaring_counter_add(croaring_counter_t *val, uint64_t n) {
+    *val += n;
+}
+
+static inline uint64_t croaring_counter_get(croaring_counter_t *val) {
+    return *val;
+}
+
+static inline void croaring_counter_reset(croaring_counter_t *val) {
+    *val = 0;
+}
+#endif
+
 
 // We need portability.h to be included first,
 // but we also always want isadetection.h to be
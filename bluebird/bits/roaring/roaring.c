@@ -119,6 +119,7 @@ static inline void add_bulk_impl(roaring_bitmap_t *r,
 
 void roaring_bitmap_add_many(roaring_bitmap_t *r, size_t n_args,
                              const uint32_t *vals) {
+    roaring_profile_add(ROARING_PROFILE_UPDATES, n_args);
     uint32_t val;
     const uint32_t *start = vals;
     const uint32_t *end = vals + n_args;
@@ -150,6 +151,7 @@ bool roaring_bitmap_contains_bulk(const roaring_bitmap_t *r,
                                   roaring_bulk_context_t *context,
                                   uint32_t val)
 {
+    roaring_profile_add(ROARING_PROFILE_CONTAINS, 1);
     uint16_t key = val >> 16;
     if (context->container == NULL || context->key != key) {
         int32_t start_idx = -1;
@@ -174,12 +176,159 @@ bool roaring_bitmap_contains_bulk(const roaring_bitmap_t *r,
     return container_contains(context->container, val & 0xFFFF, context->typecode);
 }
 
+size_t roaring_bitmap_contains_many(const roaring_bitmap_t *r, size_t n,
+                                    const uint32_t *vals, uint64_t *result) {
+    memset(result, 0, ((n + 63) / 64) * sizeof(uint64_t));
+    const roaring_array_t *ra = &r->high_low_container;
+    size_t found = 0;
+    int32_t idx = 0;
+    size_t i = 0;
+    while (i < n) {
+        // probes sharing a key go to the container in one call
+        const uint16_t key = (uint16_t)(vals[i] >> 16);
+        size_t end = i + 1;
+        while (end < n && (uint16_t)(vals[end] >> 16) == key) {
+            end++;
+        }
+        // keys usually increase, so search forward from the last position
+        int32_t start = -1;
+        if (idx < ra->size && ra->keys[idx] < key) {
+            start = idx;
+        }
+        idx = ra_advance_until(ra, key, start);
+        if (idx < ra->size && ra->keys[idx] == key) {
+            found += container_contains_many(ra->containers[idx],
+                                             ra->typecodes[idx], vals + i,
+                                             end - i, result, i);
+        }
+        i = end;
+    }
+    return found;
+}
+
+size_t roaring_bitmap_contains_many_compact(const roaring_bitmap_t *r,
+                                            size_t n, const uint32_t *vals,
+                                            uint32_t *out) {
+    enum { BATCH = 1024 };
+    uint64_t mask[BATCH / 64];
+    size_t written = 0;
+    for (size_t begin = 0; begin < n; begin += BATCH) {
+        const size_t count = (n - begin < BATCH) ? n - begin : BATCH;
+        roaring_bitmap_contains_many(r, count, vals + begin, mask);
+        // store every value but only advance past the present ones
+        for (size_t i = 0; i < count; i++) {
+            out[written] = vals[begin + i];
+            written += (mask[i >> 6] >> (i & 63)) & 1;
+        }
+    }
+    return written;
+}
+
 roaring_bitmap_t *roaring_bitmap_of_ptr(size_t n_args, const uint32_t *vals) {
     roaring_bitmap_t *answer = roaring_bitmap_create();
     roaring_bitmap_add_many(answer, n_args, vals);
     return answer;
 }
 
+// groups this small are sorted in place rather than through a bitset
+#define GROUPED_INSERTION_SORT_MAX 64
+
+roaring_bitmap_t *roaring_bitmap_of_grouped(size_t n_args, const uint32_t *vals) {
+    roaring_bitmap_t *answer = roaring_bitmap_create();
+    if (answer == NULL) {
+        return NULL;
+    }
+    uint64_t *scratch = NULL;  // one bitset container worth of words
+
+    size_t i = 0;
+    while (i < n_args) {
+        const uint16_t key = (uint16_t)(vals[i] >> 16);
+        size_t end = i + 1;
+        while (end < n_args && (vals[end] >> 16) == key) {
+            ++end;
+        }
+        assert(answer->high_low_container.size == 0 ||
+               ra_get_key_at_index(&answer->high_low_container,
+                                   answer->high_low_container.size - 1) < key);
+        const size_t count = end - i;
+        container_t *c;
+        uint8_t type;
+
+        if (count > DEFAULT_MAX_SIZE) {
+            bitset_container_t *bitset = bitset_container_create();
+            if (bitset == NULL) {
+                goto fail;
+            }
+            for (size_t j = i; j < end; ++j) {
+                const uint16_t low = (uint16_t)vals[j];
+                bitset->words[low >> 6] |= UINT64_C(1) << (low & 63);
+            }
+            bitset->cardinality = bitset_container_compute_cardinality(bitset);
+            if (bitset->cardinality <= DEFAULT_MAX_SIZE) {  // repeated values
+                c = array_container_from_bitset(bitset);
+                type = ARRAY_CONTAINER_TYPE;
+                bitset_container_free(bitset);
+            } else {
+                c = bitset;
+                type = BITSET_CONTAINER_TYPE;
+            }
+        } else {
+            array_container_t *array =
+                array_container_create_given_capacity((int32_t)count);
+            if (array == NULL) {
+                goto fail;
+            }
+            if (count <= GROUPED_INSERTION_SORT_MAX) {
+                int32_t card = 0;
+                for (size_t j = i; j < end; ++j) {
+                    const uint16_t low = (uint16_t)vals[j];
+                    int32_t pos = card;
+                    while (pos > 0 && array->array[pos - 1] > low) {
+                        --pos;
+                    }
+                    if (pos > 0 && array->array[pos - 1] == low) {
+                        continue;
+                    }
+                    memmove(array->array + pos + 1, array->array + pos,
+                            (card - pos) * sizeof(uint16_t));
+                    array->array[pos] = low;
+                    ++card;
+                }
+                array->cardinality = card;
+            } else {
+                if (scratch == NULL) {
+                    scratch = (uint64_t *)roaring_calloc(
+                        BITSET_CONTAINER_SIZE_IN_WORDS, sizeof(uint64_t));
+                    if (scratch == NULL) {
+                        array_container_free(array);
+                        goto fail;
+                    }
+                }
+                for (size_t j = i; j < end; ++j) {
+                    const uint16_t low = (uint16_t)vals[j];
+                    scratch[low >> 6] |= UINT64_C(1) << (low & 63);
+                }
+                array->cardinality = (int32_t)bitset_extract_setbits_uint16(
+                    scratch, BITSET_CONTAINER_SIZE_IN_WORDS, array->array, 0);
+                for (size_t j = i; j < end; ++j) {
+                    scratch[(uint16_t)vals[j] >> 6] = 0;
+                }
+            }
+            c = array;
+            type = ARRAY_CONTAINER_TYPE;
+        }
+        ra_append(&answer->high_low_container, key, c, type);
+        i = end;
+    }
+    roaring_free(scratch);
+    return answer;
+
+fail:
+    roaring_free(scratch);
+    roaring_bitmap_free(answer);
+    return NULL;
+}
+
 roaring_bitmap_t *roaring_bitmap_of(size_t n_args, ...) {
     // todo: could be greatly optimized but we do not expect this call to ever
     // include long lists
@@ -466,6 +615,7 @@ void roaring_bitmap_clear(roaring_bitmap_t *r) {
 }
 
 void roaring_bitmap_add(roaring_bitmap_t *r, uint32_t val) {
+    roaring_profile_add(ROARING_PROFILE_UPDATES, 1);
     roaring_array_t *ra = &r->high_low_container;
 
     const uint16_t hb = val >> 16;
@@ -494,6 +644,7 @@ void roaring_bitmap_add(roaring_bitmap_t *r, uint32_t val) {
 }
 
 bool roaring_bitmap_add_checked(roaring_bitmap_t *r, uint32_t val) {
+    roaring_profile_add(ROARING_PROFILE_UPDATES, 1);
     const uint16_t hb = val >> 16;
     const int i = ra_get_index(&r->high_low_container, hb);
     uint8_t typecode;
@@ -534,6 +685,7 @@ bool roaring_bitmap_add_checked(roaring_bitmap_t *r, uint32_t val) {
 }
 
 void roaring_bitmap_remove(roaring_bitmap_t *r, uint32_t val) {
+    roaring_profile_add(ROARING_PROFILE_UPDATES, 1);
     const uint16_t hb = val >> 16;
     const int i = ra_get_index(&r->high_low_container, hb);
     uint8_t typecode;
@@ -559,6 +711,7 @@ void roaring_bitmap_remove(roaring_bitmap_t *r, uint32_t val) {
 }
 
 bool roaring_bitmap_remove_checked(roaring_bitmap_t *r, uint32_t val) {
+    roaring_profile_add(ROARING_PROFILE_UPDATES, 1);
     const uint16_t hb = val >> 16;
     const int i = ra_get_index(&r->high_low_container, hb);
     uint8_t typecode;
@@ -632,6 +785,7 @@ void roaring_bitmap_remove_many(roaring_bitmap_t *r, size_t n_args,
 // there should be some SIMD optimizations possible here
 roaring_bitmap_t *roaring_bitmap_and(const roaring_bitmap_t *x1,
                                      const roaring_bitmap_t *x2) {
+    roaring_profile_add(ROARING_PROFILE_INTERSECTIONS, 1);
     uint8_t result_type = 0;
     const int length1 = x1->high_low_container.size,
               length2 = x2->high_low_container.size;
@@ -680,10 +834,12 @@ roaring_bitmap_t *roaring_bitmap_or_many(size_t number,
     if (number == 1) {
         return roaring_bitmap_copy(x[0]);
     }
+    const bool bitsetconversion =
+        roaring_perf_parameters.lazy_or_bitset_conversion;
     roaring_bitmap_t *answer =
-        roaring_bitmap_lazy_or(x[0], x[1], LAZY_OR_BITSET_CONVERSION);
+        roaring_bitmap_lazy_or(x[0], x[1], bitsetconversion);
     for (size_t i = 2; i < number; i++) {
-        roaring_bitmap_lazy_or_inplace(answer, x[i], LAZY_OR_BITSET_CONVERSION);
+        roaring_bitmap_lazy_or_inplace(answer, x[i], bitsetconversion);
     }
     roaring_bitmap_repair_after_lazy(answer);
     return answer;
@@ -708,9 +864,81 @@ roaring_bitmap_t *roaring_bitmap_xor_many(size_t number,
     return answer;
 }
 
+/*
+ * Returns the index of the first container of 'ra' whose key is >= 'key'
+ * (ra->size if there is none). 'key' may be 65536 to denote the end.
+ */
+static inline int32_t ra_key_lower_index(const roaring_array_t *ra,
+                                         uint32_t key) {
+    if (key > UINT16_MAX) {
+        return ra->size;
+    }
+    int32_t i = ra_get_index(ra, (uint16_t)key);
+    return i >= 0 ? i : -i - 1;
+}
+
+/*
+ * Compute the union or the xor of the containers of 'number' bitmaps whose
+ * key lies in [key_start, key_end). The inputs are read through views that
+ * share their arrays, so nothing is copied beyond what or_many/xor_many do.
+ */
+static roaring_bitmap_t *many_key_range(size_t number,
+                                        const roaring_bitmap_t **x,
+                                        uint32_t key_start, uint32_t key_end,
+                                        bool use_xor) {
+    roaring_bitmap_t *views =
+        (roaring_bitmap_t *)roaring_malloc(number * sizeof(roaring_bitmap_t));
+    const roaring_bitmap_t **nonempty = (const roaring_bitmap_t **)
+        roaring_malloc(number * sizeof(roaring_bitmap_t *));
+    if (views == NULL || nonempty == NULL) {
+        roaring_free(views);
+        roaring_free(nonempty);
+        return NULL;
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < number; i++) {
+        const roaring_array_t *ra = &x[i]->high_low_container;
+        int32_t begin = ra_key_lower_index(ra, key_start);
+        int32_t end = ra_key_lower_index(ra, key_end);
+        if (begin >= end) {
+            continue;
+        }
+        // The view must never be resized or freed: it does not own its arrays.
+        roaring_array_t *view = &views[count].high_low_container;
+        view->size = end - begin;
+        view->allocation_size = end - begin;
+        view->containers = ra->containers + begin;
+        view->keys = ra->keys + begin;
+        view->typecodes = ra->typecodes + begin;
+        view->flags = ra->flags;
+        nonempty[count] = &views[count];
+        count++;
+    }
+    roaring_bitmap_t *answer = use_xor ? roaring_bitmap_xor_many(count, nonempty)
+                                       : roaring_bitmap_or_many(count, nonempty);
+    roaring_free(nonempty);
+    roaring_free(views);
+    return answer;
+}
+
+roaring_bitmap_t *roaring_bitmap_or_many_key_range(size_t number,
+                                                   const roaring_bitmap_t **x,
+                                                   uint32_t key_start,
+                                                   uint32_t key_end) {
+    return many_key_range(number, x, key_start, key_end, false);
+}
+
+roaring_bitmap_t *roaring_bitmap_xor_many_key_range(size_t number,
+                                                    const roaring_bitmap_t **x,
+                                                    uint32_t key_start,
+                                                    uint32_t key_end) {
+    return many_key_range(number, x, key_start, key_end, true);
+}
+
 // inplace and (modifies its first argument).
 void roaring_bitmap_and_inplace(roaring_bitmap_t *x1,
                                 const roaring_bitmap_t *x2) {
+    roaring_profile_add(ROARING_PROFILE_INTERSECTIONS, 1);
     if (x1 == x2) return;
     int pos1 = 0, pos2 = 0, intersection_size = 0;
     const int length1 = ra_get_size(&x1->high_low_container);
@@ -774,6 +1002,7 @@ void roaring_bitmap_and_inplace(roaring_bitmap_t *x1,
 
 roaring_bitmap_t *roaring_bitmap_or(const roaring_bitmap_t *x1,
                                     const roaring_bitmap_t *x2) {
+    roaring_profile_add(ROARING_PROFILE_UNIONS, 1);
     uint8_t result_type = 0;
     const int length1 = x1->high_low_container.size,
               length2 = x2->high_low_container.size;
@@ -853,6 +1082,7 @@ roaring_bitmap_t *roaring_bitmap_or(const roaring_bitmap_t *x1,
 // inplace or (modifies its first argument).
 void roaring_bitmap_or_inplace(roaring_bitmap_t *x1,
                                const roaring_bitmap_t *x2) {
+    roaring_profile_add(ROARING_PROFILE_UNIONS, 1);
     uint8_t result_type = 0;
     int length1 = x1->high_low_container.size;
     const int length2 = x2->high_low_container.size;
@@ -925,6 +1155,7 @@ void roaring_bitmap_or_inplace(roaring_bitmap_t *x1,
 
 roaring_bitmap_t *roaring_bitmap_xor(const roaring_bitmap_t *x1,
                                      const roaring_bitmap_t *x2) {
+    roaring_profile_add(ROARING_PROFILE_UNIONS, 1);
     uint8_t result_type = 0;
     const int length1 = x1->high_low_container.size,
               length2 = x2->high_low_container.size;
@@ -1004,6 +1235,7 @@ roaring_bitmap_t *roaring_bitmap_xor(const roaring_bitmap_t *x1,
 
 void roaring_bitmap_xor_inplace(roaring_bitmap_t *x1,
                                 const roaring_bitmap_t *x2) {
+    roaring_profile_add(ROARING_PROFILE_UNIONS, 1);
     assert(x1 != x2);
     uint8_t result_type = 0;
     int length1 = x1->high_low_container.size;
@@ -1092,6 +1324,7 @@ void roaring_bitmap_xor_inplace(roaring_bitmap_t *x1,
 
 roaring_bitmap_t *roaring_bitmap_andnot(const roaring_bitmap_t *x1,
                                         const roaring_bitmap_t *x2) {
+    roaring_profile_add(ROARING_PROFILE_INTERSECTIONS, 1);
     uint8_t result_type = 0;
     const int length1 = x1->high_low_container.size,
               length2 = x2->high_low_container.size;
@@ -1158,6 +1391,7 @@ roaring_bitmap_t *roaring_bitmap_andnot(const roaring_bitmap_t *x1,
 
 void roaring_bitmap_andnot_inplace(roaring_bitmap_t *x1,
                                    const roaring_bitmap_t *x2) {
+    roaring_profile_add(ROARING_PROFILE_INTERSECTIONS, 1);
     assert(x1 != x2);
 
     uint8_t result_type = 0;
@@ -1315,6 +1549,215 @@ uint64_t roaring_bitmap_range_cardinality(const roaring_bitmap_t *r,
     return card;
 }
 
+/* Intersection of `c` with [lo, hi] (inclusive 16-bit bounds), as a new
+ * container. The range itself is a single-run container on the stack. */
+static container_t *container_and_range(const container_t *c, uint8_t type,
+                                        uint32_t lo, uint32_t hi,
+                                        uint8_t *result_type) {
+    rle16_t run;
+    run.value = (uint16_t)lo;
+    run.length = (uint16_t)(hi - lo);
+    run_container_t range;
+    range.n_runs = 1;
+    range.capacity = 1;
+    range.runs = &run;
+    return container_and(c, type, &range, RUN_CONTAINER_TYPE, result_type);
+}
+
+enum { ROARING_RANGE_AND, ROARING_RANGE_OR, ROARING_RANGE_ANDNOT };
+
+/* Computes (x1 op x2) restricted to [range_start, range_end), visiting only
+ * the containers whose keys fall in the range. Only the first and last
+ * containers of the range may need clipping. */
+static roaring_bitmap_t *roaring_bitmap_op_range(const roaring_bitmap_t *x1,
+                                                 const roaring_bitmap_t *x2,
+                                                 uint64_t range_start,
+                                                 uint64_t range_end, int op) {
+    roaring_bitmap_t *answer = roaring_bitmap_create();
+    if (answer == NULL) {
+        return NULL;
+    }
+    roaring_bitmap_set_copy_on_write(answer, is_cow(x1) || is_cow(x2));
+    if (range_end > UINT32_MAX) {
+        range_end = UINT32_MAX + UINT64_C(1);
+    }
+    if (range_start >= range_end) {
+        return answer;
+    }
+    range_end--;  // make range_end inclusive
+    const uint16_t minhb = (uint16_t)(range_start >> 16);
+    const uint16_t maxhb = (uint16_t)(range_end >> 16);
+    const roaring_array_t *ra1 = &x1->high_low_container;
+    const roaring_array_t *ra2 = &x2->high_low_container;
+    int32_t pos1 = ra_advance_until(ra1, minhb, -1);
+    int32_t pos2 = ra_advance_until(ra2, minhb, -1);
+
+    for (;;) {
+        const bool has1 = pos1 < ra1->size && ra1->keys[pos1] <= maxhb;
+        const bool has2 = pos2 < ra2->size && ra2->keys[pos2] <= maxhb;
+        if (!has1 && (op != ROARING_RANGE_OR || !has2)) break;
+        if (!has2 && op == ROARING_RANGE_AND) break;
+        const uint16_t k1 = has1 ? ra1->keys[pos1] : 0;
+        const uint16_t k2 = has2 ? ra2->keys[pos2] : 0;
+        uint16_t key;
+        container_t *c1 = NULL, *c2 = NULL;
+        uint8_t type1 = 0, type2 = 0;
+        if (has1 && has2 && k1 == k2) {
+            key = k1;
+            c1 = ra_get_container_at_index(ra1, pos1++, &type1);
+            c2 = ra_get_container_at_index(ra2, pos2++, &type2);
+        } else if (has1 && (!has2 || k1 < k2)) {
+            if (op == ROARING_RANGE_AND) {
+                pos1 = ra_advance_until(ra1, k2, pos1);
+                continue;
+            }
+            key = k1;
+            c1 = ra_get_container_at_index(ra1, pos1++, &type1);
+        } else {
+            if (op != ROARING_RANGE_OR) {
+                pos2 = ra_advance_until(ra2, k1, pos2);
+                continue;
+            }
+            key = k2;
+            c2 = ra_get_container_at_index(ra2, pos2++, &type2);
+        }
+
+        const uint32_t lo = (key == minhb) ? (uint32_t)(range_start & 0xFFFF) : 0;
+        const uint32_t hi = (key == maxhb) ? (uint32_t)(range_end & 0xFFFF) : 0xFFFF;
+        const bool clip = (lo != 0) || (hi != 0xFFFF);
+        container_t *c;
+        uint8_t type;
+        if (c1 != NULL && c2 != NULL) {
+            if (op == ROARING_RANGE_AND) {
+                c = container_and(c1, type1, c2, type2, &type);
+            } else if (op == ROARING_RANGE_OR) {
+                c = container_or(c1, type1, c2, type2, &type);
+            } else {
+                c = container_andnot(c1, type1, c2, type2, &type);
+            }
+            if (c != NULL && clip) {
+                uint8_t clipped_type;
+                container_t *clipped = container_and_range(c, type, lo, hi,
+                                                           &clipped_type);
+                container_free(c, type);
+                c = clipped;
+                type = clipped_type;
+            }
+        } else {
+            container_t *src = (c1 != NULL) ? c1 : c2;
+            type = (c1 != NULL) ? type1 : type2;
+            if (clip) {
+                c = container_and_range(src, type, lo, hi, &type);
+            } else {
+                // shares the container when it is already shared
+                c = get_copy_of_container(src, &type,
+                                          type == SHARED_CONTAINER_TYPE);
+            }
+        }
+        if (c == NULL) {
+            roaring_bitmap_free(answer);
+            return NULL;
+        }
+        if (container_nonzero_cardinality(c, type)) {
+            ra_append(&answer->high_low_container, key, c, type);
+        } else {
+            container_free(c, type);
+        }
+    }
+    return answer;
+}
+
+roaring_bitmap_t *roaring_bitmap_and_range(const roaring_bitmap_t *x1,
+                                           const roaring_bitmap_t *x2,
+                                           uint64_t range_start,
+                                           uint64_t range_end) {
+    return roaring_bitmap_op_range(x1, x2, range_start, range_end,
+                                   ROARING_RANGE_AND);
+}
+
+roaring_bitmap_t *roaring_bitmap_or_range(const roaring_bitmap_t *x1,
+                                          const roaring_bitmap_t *x2,
+                                          uint64_t range_start,
+                                          uint64_t range_end) {
+    return roaring_bitmap_op_range(x1, x2, range_start, range_end,
+                                   ROARING_RANGE_OR);
+}
+
+roaring_bitmap_t *roaring_bitmap_andnot_range(const roaring_bitmap_t *x1,
+                                              const roaring_bitmap_t *x2,
+                                              uint64_t range_start,
+                                              uint64_t range_end) {
+    return roaring_bitmap_op_range(x1, x2, range_start, range_end,
+                                   ROARING_RANGE_ANDNOT);
+}
+
+uint64_t roaring_bitmap_and_cardinality_range(const roaring_bitmap_t *x1,
+                                              const roaring_bitmap_t *x2,
+                                              uint64_t range_start,
+                                              uint64_t range_end) {
+    if (range_end > UINT32_MAX) {
+        range_end = UINT32_MAX + UINT64_C(1);
+    }
+    if (range_start >= range_end) {
+        return 0;
+    }
+    range_end--;  // make range_end inclusive
+    const uint16_t minhb = (uint16_t)(range_start >> 16);
+    const uint16_t maxhb = (uint16_t)(range_end >> 16);
+    const roaring_array_t *ra1 = &x1->high_low_container;
+    const roaring_array_t *ra2 = &x2->high_low_container;
+    int32_t pos1 = ra_advance_until(ra1, minhb, -1);
+    int32_t pos2 = ra_advance_until(ra2, minhb, -1);
+    uint64_t answer = 0;
+    while (pos1 < ra1->size && pos2 < ra2->size) {
+        const uint16_t k1 = ra1->keys[pos1];
+        const uint16_t k2 = ra2->keys[pos2];
+        if (k1 > maxhb || k2 > maxhb) {
+            break;
+        }
+        if (k1 < k2) {
+            pos1 = ra_advance_until(ra1, k2, pos1);
+            continue;
+        }
+        if (k2 < k1) {
+            pos2 = ra_advance_until(ra2, k1, pos2);
+            continue;
+        }
+        uint8_t type1, type2;
+        const container_t *c1 = ra_get_container_at_index(ra1, pos1++, &type1);
+        const container_t *c2 = ra_get_container_at_index(ra2, pos2++, &type2);
+        const uint32_t lo = (k1 == minhb) ? (uint32_t)(range_start & 0xFFFF) : 0;
+        const uint32_t hi = (k1 == maxhb) ? (uint32_t)(range_end & 0xFFFF) : 0xFFFF;
+        if (lo == 0 && hi == 0xFFFF) {
+            answer += container_and_cardinality(c1, type1, c2, type2);
+        } else {
+            uint8_t clipped_type;
+            container_t *clipped = container_and_range(c2, type2, lo, hi,
+                                                       &clipped_type);
+            answer += container_and_cardinality(c1, type1, clipped, clipped_type);
+            container_free(clipped, clipped_type);
+        }
+    }
+    return answer;
+}
+
+uint64_t roaring_bitmap_or_cardinality_range(const roaring_bitmap_t *x1,
+                                             const roaring_bitmap_t *x2,
+                                             uint64_t range_start,
+                                             uint64_t range_end) {
+    return roaring_bitmap_range_cardinality(x1, range_start, range_end) +
+           roaring_bitmap_range_cardinality(x2, range_start, range_end) -
+           roaring_bitmap_and_cardinality_range(x1, x2, range_start, range_end);
+}
+
+uint64_t roaring_bitmap_andnot_cardinality_range(const roaring_bitmap_t *x1,
+                                                 const roaring_bitmap_t *x2,
+                                                 uint64_t range_start,
+                                                 uint64_t range_end) {
+    return roaring_bitmap_range_cardinality(x1, range_start, range_end) -
+           roaring_bitmap_and_cardinality_range(x1, x2, range_start, range_end);
+}
+
 
 bool roaring_bitmap_is_empty(const roaring_bitmap_t *r) {
     return r->high_low_container.size == 0;
@@ -1458,6 +1901,32 @@ size_t roaring_bitmap_portable_serialize(const roaring_bitmap_t *r,
     return ra_portable_serialize(&r->high_low_container, buf);
 }
 
+// A read-only view of the containers [begin, end) of 'ra'.
+static roaring_array_t ra_range_view(const roaring_array_t *ra, int32_t begin,
+                                     int32_t end) {
+    assert(0 <= begin && begin <= end && end <= ra->size);
+    roaring_array_t view = *ra;
+    view.size = end - begin;
+    view.allocation_size = end - begin;
+    view.containers += begin;
+    view.keys += begin;
+    view.typecodes += begin;
+    return view;
+}
+
+size_t roaring_bitmap_portable_size_in_bytes_range(const roaring_bitmap_t *r,
+                                                   int32_t begin, int32_t end) {
+    roaring_array_t view = ra_range_view(&r->high_low_container, begin, end);
+    return ra_portable_size_in_bytes(&view);
+}
+
+size_t roaring_bitmap_portable_serialize_range(const roaring_bitmap_t *r,
+                                               int32_t begin, int32_t end,
+                                               char *buf) {
+    roaring_array_t view = ra_range_view(&r->high_low_container, begin, end);
+    return ra_portable_serialize(&view, buf);
+}
+
 roaring_bitmap_t *roaring_bitmap_deserialize(const void *buf) {
     const char *bufaschar = (const char *)buf;
     if (bufaschar[0] == CROARING_SERIALIZATION_ARRAY_UINT32) {
@@ -1858,6 +2327,31 @@ uint32_t roaring_read_uint32_iterator(roaring_uint32_iterator_t *it, uint32_t* b
         bcont = const_CAST_bitset(it->container);
         wordindex = it->in_container_index / 64;
         word = bcont->words[wordindex] & (UINT64_MAX << (it->in_container_index % 64));
+#if CROARING_IS_X64
+        if ((count - ret >= 64) && (croaring_hardware_support() & ROARING_SUPPORTS_AVX2)) {
+          // finish the current word, then hand the following words to the
+          // vectorized decoder, which stops once the buffer is full
+          while (word != 0) {
+            buf[0] = it->highbits | (wordindex * 64 + roaring_trailing_zeroes(word));
+            word = word & (word - 1);
+            buf++;
+            ret++;
+          }
+          size_t written = bitset_extract_setbits_avx2(
+              bcont->words + wordindex + 1,
+              BITSET_CONTAINER_SIZE_IN_WORDS - wordindex - 1, buf, count - ret,
+              it->highbits | ((wordindex + 1) * 64));
+          buf += written;
+          ret += (uint32_t)written;
+          // resume the scan right after the last value written
+          wordindex = BITSET_CONTAINER_SIZE_IN_WORDS - 1;
+          if (ret == count && (buf[-1] & 0xFFFF) != 0xFFFF) {
+            uint32_t next = (buf[-1] & 0xFFFF) + 1;
+            wordindex = next / 64;
+            word = bcont->words[wordindex] & (UINT64_MAX << (next % 64));
+          }
+        }
+#endif
         do {
           while (word != 0 && ret < count) {
             buf[0] = it->highbits | (wordindex * 64 + roaring_trailing_zeroes(word));
@@ -1927,6 +2421,180 @@ uint32_t roaring_read_uint32_iterator(roaring_uint32_iterator_t *it, uint32_t* b
 }
 
 
+/* First run index >= pos whose last value is >= min, or n_runs. */
+static inline int32_t run_advance_until(const run_container_t *rc,
+                                        int32_t pos, uint16_t min) {
+    const rle16_t *runs = rc->runs;
+    const int32_t n = rc->n_runs;
+    if (pos >= n || runs[pos].value + runs[pos].length >= min) {
+        return pos;
+    }
+    int32_t span = 1;
+    while (pos + span < n &&
+           runs[pos + span].value + runs[pos + span].length < min) {
+        span <<= 1;
+    }
+    // runs[lower] ends before min, the answer is in (lower, upper]
+    int32_t lower = pos + (span >> 1);
+    int32_t upper = pos + span < n ? pos + span : n;
+    while (lower + 1 < upper) {
+        int32_t middle = (lower + upper) >> 1;
+        if (runs[middle].value + runs[middle].length < min) {
+            lower = middle;
+        } else {
+            upper = middle;
+        }
+    }
+    return upper;
+}
+
+bool roaring_skip_uint32_iterator_to(roaring_uint32_iterator_t *it,
+                                     uint32_t val) {
+    if (!it->has_value || it->current_value >= val) {
+        return it->has_value;
+    }
+    const roaring_array_t *ra = &it->parent->high_low_container;
+    const uint16_t hb = val >> 16;
+    const uint16_t lb = val & 0xFFFF;
+    if ((it->current_value >> 16) == hb) {
+        // gallop forward from the current position in the container
+        switch (it->typecode) {
+            case BITSET_CONTAINER_TYPE: {
+                int idx = bitset_container_index_equalorlarger(
+                    const_CAST_bitset(it->container), lb);
+                if (idx >= 0) {
+                    it->in_container_index = idx;
+                    it->current_value = it->highbits | (uint32_t)idx;
+                    return true;
+                }
+                break;
+            }
+            case ARRAY_CONTAINER_TYPE: {
+                const array_container_t *ac = const_CAST_array(it->container);
+                int32_t idx = advanceUntil(ac->array, it->in_container_index,
+                                           ac->cardinality, lb);
+                if (idx < ac->cardinality) {
+                    it->in_container_index = idx;
+                    it->current_value = it->highbits | ac->array[idx];
+                    return true;
+                }
+                break;
+            }
+            case RUN_CONTAINER_TYPE: {
+                const run_container_t *rc = const_CAST_run(it->container);
+                int32_t idx = run_advance_until(rc, it->run_index, lb);
+                if (idx < rc->n_runs) {
+                    it->run_index = idx;
+                    uint32_t start = it->highbits | rc->runs[idx].value;
+                    it->current_value = start > val ? start : val;
+                    return true;
+                }
+                break;
+            }
+            default:
+                assert(false);
+        }
+        it->container_index++;
+        return (it->has_value = loadfirstvalue(it));
+    }
+    // gallop over the keys that follow the current container
+    int32_t i = ra_advance_until(ra, hb, it->container_index);
+    if (i < ra->size && ra->keys[i] == hb) {
+        if (container_maximum(ra->containers[i], ra->typecodes[i]) >= lb) {
+            it->container_index = i;
+            return (it->has_value = loadfirstvalue_largeorequal(it, val));
+        }
+        i++;
+    }
+    it->container_index = i;
+    return (it->has_value = loadfirstvalue(it));
+}
+
+uint32_t roaring_read_previous_uint32_iterator(roaring_uint32_iterator_t *it,
+                                               uint32_t *buf, uint32_t count) {
+  uint32_t ret = 0;
+  while (it->has_value && ret < count) {
+    switch (it->typecode) {
+      case BITSET_CONTAINER_TYPE: {
+        const bitset_container_t *bc = const_CAST_bitset(it->container);
+        int32_t wordindex = it->in_container_index / 64;
+        uint64_t word = bc->words[wordindex] &
+                        (UINT64_MAX >> (63 - it->in_container_index % 64));
+        for (;;) {
+          while (word != 0 && ret < count) {
+            int top = 63 - roaring_leading_zeroes(word);
+            buf[ret++] = it->highbits | (uint32_t)(wordindex * 64 + top);
+            word ^= UINT64_C(1) << top;
+          }
+          if (word != 0 || wordindex == 0) {
+            break;
+          }
+          word = bc->words[--wordindex];
+        }
+        if (word != 0) {
+          it->in_container_index =
+              wordindex * 64 + 63 - roaring_leading_zeroes(word);
+          it->current_value = it->highbits | it->in_container_index;
+          return ret;
+        }
+        break;
+      }
+      case ARRAY_CONTAINER_TYPE: {
+        const array_container_t *ac = const_CAST_array(it->container);
+        uint32_t num_values = it->in_container_index + 1;
+        if (num_values > count - ret) {
+          num_values = count - ret;
+        }
+        for (uint32_t i = 0; i < num_values; i++) {
+          buf[ret + i] =
+              it->highbits | ac->array[it->in_container_index - (int32_t)i];
+        }
+        ret += num_values;
+        it->in_container_index -= num_values;
+        if (it->in_container_index >= 0) {
+          it->current_value =
+              it->highbits | ac->array[it->in_container_index];
+          return ret;
+        }
+        break;
+      }
+      case RUN_CONTAINER_TYPE: {
+        const run_container_t *rc = const_CAST_run(it->container);
+        while (ret < count) {
+          uint32_t smallest = it->highbits | rc->runs[it->run_index].value;
+          uint32_t remaining = it->current_value - smallest + 1;
+          uint32_t num_values =
+              remaining < count - ret ? remaining : count - ret;
+          for (uint32_t i = 0; i < num_values; i++) {
+            buf[ret + i] = it->current_value - i;
+          }
+          ret += num_values;
+          if (num_values < remaining) {
+            it->current_value -= num_values;
+            return ret;
+          }
+          if (--it->run_index < 0) {
+            break;
+          }
+          it->current_value = it->highbits |
+                              (rc->runs[it->run_index].value +
+                               rc->runs[it->run_index].length);
+        }
+        if (it->run_index >= 0) {
+          return ret;
+        }
+        break;
+      }
+      default:
+        assert(false);
+    }
+    it->container_index--;
+    it->has_value = loadlastvalue(it);
+  }
+  return ret;
+}
+
+
 
 void roaring_free_uint32_iterator(roaring_uint32_iterator_t *it) { roaring_free(it); }
 
@@ -2298,9 +2966,109 @@ roaring_bitmap_t *roaring_bitmap_add_offset(const roaring_bitmap_t *bm,
     return answer;
 }
 
+bool roaring_bitmap_add_offset_inplace(roaring_bitmap_t *r, int64_t offset) {
+    if (((uint64_t)offset & 0xFFFF) != 0) {
+        return false;
+    }
+    if (offset == 0) {
+        return true;
+    }
+
+    roaring_array_t *ra = &r->high_low_container;
+    const int64_t container_offset = offset >> 16;
+
+    // keys are sorted: the containers kept are a contiguous range
+    int32_t begin = 0, end = ra->size;
+    while (begin < end && ra->keys[begin] + container_offset < 0) {
+        container_free(ra->containers[begin], ra->typecodes[begin]);
+        ++begin;
+    }
+    while (end > begin && ra->keys[end - 1] + container_offset >= (1 << 16)) {
+        --end;
+        container_free(ra->containers[end], ra->typecodes[end]);
+    }
+    if (begin > 0 && begin < end) {
+        ra_copy_range(ra, begin, end, 0);
+    }
+    ra_downsize(ra, end - begin);
+
+    for (int32_t i = 0; i < ra->size; ++i) {
+        ra->keys[i] = (uint16_t)(ra->keys[i] + container_offset);
+    }
+    return true;
+}
+
+// Move every container of 'src' to the end of 'ra', whose last key must not
+// be above the first key of 'src'. Equal keys are merged; either container
+// may be shared. 'src' is left empty.
+static void append_move_with_merge(roaring_array_t *ra, roaring_array_t *src) {
+    int32_t i = 0;
+    int32_t size = ra_get_size(ra);
+    if (size > 0 && src->size > 0 &&
+        ra_get_key_at_index(ra, size - 1) == ra_get_key_at_index(src, 0)) {
+        uint8_t last_t, first_t, t1, t2, new_t;
+        container_t *last_c = ra_get_container_at_index(ra, size - 1, &last_t);
+        container_t *first_c = ra_get_container_at_index(src, 0, &first_t);
+        t1 = last_t;
+        t2 = first_t;
+        const container_t *c1 = container_unwrap_shared(last_c, &t1);
+        const container_t *c2 = container_unwrap_shared(first_c, &t2);
+        container_t *new_c = container_or(c1, t1, c2, t2, &new_t);
+        container_free(last_c, last_t);
+        container_free(first_c, first_t);
+        ra_set_container_at_index(ra, size - 1, new_c, new_t);
+        i = 1;
+    }
+    for (; i < src->size; ++i) {
+        ra_append(ra, src->keys[i], src->containers[i], src->typecodes[i]);
+    }
+    src->size = 0;
+}
+
+roaring_bitmap_t *roaring_bitmap_merge_segments(size_t n,
+                                               const roaring_bitmap_t **inputs,
+                                               const int64_t *offsets,
+                                               const roaring_bitmap_t **deletions) {
+    roaring_bitmap_t *answer = roaring_bitmap_create();
+    if (n == 0) {
+        return answer;
+    }
+    roaring_bitmap_set_copy_on_write(answer, is_cow(inputs[0]));
+    roaring_array_t *ans_ra = &answer->high_low_container;
+
+    for (size_t i = 0; i < n; ++i) {
+        roaring_bitmap_t *part;
+        if (deletions != NULL && deletions[i] != NULL) {
+            // the difference is ours: shift it in place when we can
+            part = roaring_bitmap_andnot(inputs[i], deletions[i]);
+            if (!roaring_bitmap_add_offset_inplace(part, offsets[i])) {
+                roaring_bitmap_t *live = part;
+                part = roaring_bitmap_add_offset(live, offsets[i]);
+                roaring_bitmap_free(live);
+            }
+        } else {
+            part = roaring_bitmap_add_offset(inputs[i], offsets[i]);
+        }
+
+        roaring_array_t *part_ra = &part->high_low_container;
+        if (part_ra->size > 0) {
+            if (ans_ra->size == 0 ||
+                ra_get_key_at_index(part_ra, 0) >=
+                    ra_get_key_at_index(ans_ra, ans_ra->size - 1)) {
+                append_move_with_merge(ans_ra, part_ra);
+            } else {
+                roaring_bitmap_or_inplace(answer, part);
+            }
+        }
+        roaring_bitmap_free(part);
+    }
+    return answer;
+}
+
 roaring_bitmap_t *roaring_bitmap_lazy_or(const roaring_bitmap_t *x1,
                                          const roaring_bitmap_t *x2,
                                          const bool bitsetconversion) {
+    roaring_profile_add(ROARING_PROFILE_UNIONS, 1);
     uint8_t result_type = 0;
     const int length1 = x1->high_low_container.size,
               length2 = x2->high_low_container.size;
@@ -2332,6 +3100,7 @@ roaring_bitmap_t *roaring_bitmap_lazy_or(const roaring_bitmap_t *x1,
                     container_mutable_unwrap_shared(c1, &type1);
                 newc1 = container_to_bitset(newc1, type1);
                 type1 = BITSET_CONTAINER_TYPE;
+                roaring_profile_add(ROARING_PROFILE_LAZY_ARRAY_TO_BITSET, 1);
                 c = container_lazy_ior(newc1, type1, c2, type2,
                                        &result_type);
                 if (c != newc1) {  // should not happen
@@ -2394,6 +3163,7 @@ roaring_bitmap_t *roaring_bitmap_lazy_or(const roaring_bitmap_t *x1,
 void roaring_bitmap_lazy_or_inplace(roaring_bitmap_t *x1,
                                     const roaring_bitmap_t *x2,
                                     const bool bitsetconversion) {
+    roaring_profile_add(ROARING_PROFILE_UNIONS, 1);
     uint8_t result_type = 0;
     int length1 = x1->high_low_container.size;
     const int length2 = x2->high_low_container.size;
@@ -2425,6 +3195,8 @@ void roaring_bitmap_lazy_or_inplace(roaring_bitmap_t *x1,
                     c1 = container_to_bitset(c1, type1);
                     container_free(old_c1, old_type1);
                     type1 = BITSET_CONTAINER_TYPE;
+                    roaring_profile_add(ROARING_PROFILE_LAZY_ARRAY_TO_BITSET,
+                                        1);
                 }
 
                 container_t *c2 = ra_get_container_at_index(
@@ -2658,6 +3430,7 @@ void roaring_bitmap_repair_after_lazy(roaring_bitmap_t *r) {
 * to x.
 */
 uint64_t roaring_bitmap_rank(const roaring_bitmap_t *bm, uint32_t x) {
+    roaring_profile_add(ROARING_PROFILE_CONTAINS, 1);
     uint64_t size = 0;
     uint32_t xhigh = x >> 16;
     for (int i = 0; i < bm->high_low_container.size; i++) {
@@ -2764,6 +3537,7 @@ bool roaring_bitmap_select(const roaring_bitmap_t *bm, uint32_t rank,
 
 bool roaring_bitmap_intersect(const roaring_bitmap_t *x1,
                                      const roaring_bitmap_t *x2) {
+    roaring_profile_add(ROARING_PROFILE_INTERSECTIONS, 1);
     const int length1 = x1->high_low_container.size,
               length2 = x2->high_low_container.size;
     uint64_t answer = 0;
@@ -2814,6 +3588,7 @@ bool roaring_bitmap_intersect_with_range(const roaring_bitmap_t *bm,
 
 uint64_t roaring_bitmap_and_cardinality(const roaring_bitmap_t *x1,
                                         const roaring_bitmap_t *x2) {
+    roaring_profile_add(ROARING_PROFILE_INTERSECTIONS, 1);
     const int length1 = x1->high_low_container.size,
               length2 = x2->high_low_container.size;
     uint64_t answer = 0;
@@ -2873,6 +3648,7 @@ uint64_t roaring_bitmap_xor_cardinality(const roaring_bitmap_t *x1,
 
 
 bool roaring_bitmap_contains(const roaring_bitmap_t *r, uint32_t val) {
+    roaring_profile_add(ROARING_PROFILE_CONTAINS, 1);
     const uint16_t hb = val >> 16;
     /*
      * the next function call involves a binary search and lots of branching.
@@ -2893,6 +3669,7 @@ bool roaring_bitmap_contains(const roaring_bitmap_t *r, uint32_t val) {
  * Check whether a range of values from range_start (included) to range_end (excluded) is present
  */
 bool roaring_bitmap_contains_range(const roaring_bitmap_t *r, uint64_t range_start, uint64_t range_end) {
+    roaring_profile_add(ROARING_PROFILE_CONTAINS, 1);
     if(range_end >= UINT64_C(0x100000000)) {
         range_end = UINT64_C(0x100000000);
     }
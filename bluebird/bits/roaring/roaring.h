@@ -65,6 +65,15 @@ roaring_bitmap_t *roaring_bitmap_from_range(uint64_t min, uint64_t max,
  */
 roaring_bitmap_t *roaring_bitmap_of_ptr(size_t n_args, const uint32_t *vals);
 
+/**
+ * Creates a new bitmap from 'n_args' integers grouped by their 16 high bits,
+ * the groups in increasing order: e.g. the output of a radix pass on the high
+ * bits. Within a group the values may come in any order and repeat. Each
+ * group is turned into a container directly, without going through the
+ * insertion path.
+ */
+roaring_bitmap_t *roaring_bitmap_of_grouped(size_t n_args, const uint32_t *vals);
+
 /*
  * Whether you want to use copy-on-write.
  * Saves memory and avoids copies, but needs more care in a threaded context.
@@ -86,8 +95,38 @@ static inline void roaring_bitmap_set_copy_on_write(roaring_bitmap_t* r,
     }
 }
 
+/**
+ * Add 'offset' to every value of 'bm', dropping the values that land outside
+ * of [0, 2^32), and return the result as a new bitmap. Containers are moved
+ * whole and split in two only when 'offset' is not a multiple of 2^16.
+ */
 roaring_bitmap_t *roaring_bitmap_add_offset(const roaring_bitmap_t *bm,
                                             int64_t offset);
+
+/**
+ * Same as roaring_bitmap_add_offset but in place, for an 'offset' that is a
+ * multiple of 2^16: only the container keys change. Returns false, leaving
+ * 'r' untouched, for any other offset.
+ */
+bool roaring_bitmap_add_offset_inplace(roaring_bitmap_t *r, int64_t offset);
+
+/**
+ * Merge 'n' segments into a new bitmap: for each i, the values of inputs[i]
+ * that are not in deletions[i], plus offsets[i]. 'deletions', or any of its
+ * entries, may be NULL for no deletions. Values that land outside of
+ * [0, 2^32) are dropped.
+ *
+ * Each segment is shifted with roaring_bitmap_add_offset and its containers
+ * are moved to the end of the result, merging only the container on the
+ * boundary. Inputs sorted by offset with disjoint shifted ranges are merged in
+ * a single pass; a segment overlapping the result beyond its last container
+ * falls back to roaring_bitmap_or_inplace.
+ */
+roaring_bitmap_t *roaring_bitmap_merge_segments(size_t n,
+                                               const roaring_bitmap_t **inputs,
+                                               const int64_t *offsets,
+                                               const roaring_bitmap_t **deletions);
+
 /**
  * Describe the inner structure of the bitmap.
  */
@@ -237,6 +276,31 @@ void roaring_bitmap_xor_inplace(roaring_bitmap_t *r1,
 roaring_bitmap_t *roaring_bitmap_xor_many(size_t number,
                                           const roaring_bitmap_t **rs);
 
+/**
+ * Compute the union of the containers of 'number' bitmaps whose 16-bit key
+ * (the high 16 bits of their values) lies in [key_start, key_end), with
+ * key_end <= 65536. Containers outside the range are not visited.
+ *
+ * Calls on disjoint key ranges touch disjoint containers of the inputs, so
+ * they can run concurrently on the same inputs; this is how the C++
+ * `Bitmap::fastunion(n, inputs, executor)` splits a wide union across threads.
+ * Caller is responsible for freeing the result.
+ */
+roaring_bitmap_t *roaring_bitmap_or_many_key_range(size_t number,
+                                                   const roaring_bitmap_t **rs,
+                                                   uint32_t key_start,
+                                                   uint32_t key_end);
+
+/**
+ * Compute the xor of the containers of 'number' bitmaps whose 16-bit key lies
+ * in [key_start, key_end). See `roaring_bitmap_or_many_key_range()`.
+ * Caller is responsible for freeing the result.
+ */
+roaring_bitmap_t *roaring_bitmap_xor_many_key_range(size_t number,
+                                                    const roaring_bitmap_t **rs,
+                                                    uint32_t key_start,
+                                                    uint32_t key_end);
+
 /**
  * Computes the difference (andnot) between two bitmaps and returns new bitmap.
  * Caller is responsible for freeing the result.
@@ -402,6 +466,29 @@ bool roaring_bitmap_contains_bulk(const roaring_bitmap_t *r,
                                   roaring_bulk_context_t *context,
                                   uint32_t val);
 
+/**
+ * Check whether each of the n values in `vals` is present, setting bit i of
+ * `result` (bit i % 64 of result[i / 64]) to the answer for vals[i]. `result`
+ * must have room for (n + 63) / 64 words; it is overwritten, including the
+ * unused high bits of the last word. Returns the number of values present.
+ *
+ * Consecutive values sharing their 16 most significant bits are handed to
+ * their container as a group, and the container lookups themselves do not
+ * branch on the values. Grouping the probes by high bits, e.g. by sorting
+ * them, gives the best performance; any order is accepted.
+ */
+size_t roaring_bitmap_contains_many(const roaring_bitmap_t *r, size_t n,
+                                    const uint32_t *vals, uint64_t *result);
+
+/**
+ * Like roaring_bitmap_contains_many, except that the values present are
+ * copied, in input order, to `out`, which must have room for n values.
+ * Returns the number of values written.
+ */
+size_t roaring_bitmap_contains_many_compact(const roaring_bitmap_t *r,
+                                            size_t n, const uint32_t *vals,
+                                            uint32_t *out);
+
 /**
  * Get the cardinality of the bitmap (number of elements).
  */
@@ -414,6 +501,64 @@ uint64_t roaring_bitmap_range_cardinality(const roaring_bitmap_t *r,
                                           uint64_t range_start,
                                           uint64_t range_end);
 
+/**
+ * Computes the intersection between two bitmaps restricted to the values in
+ * [range_start, range_end), and returns new bitmap. Only the containers whose
+ * keys fall in the range are visited, and at most the first and the last of
+ * them are clipped. The caller is responsible for memory management.
+ */
+roaring_bitmap_t *roaring_bitmap_and_range(const roaring_bitmap_t *r1,
+                                           const roaring_bitmap_t *r2,
+                                           uint64_t range_start,
+                                           uint64_t range_end);
+
+/**
+ * Computes the union between two bitmaps restricted to the values in
+ * [range_start, range_end), and returns new bitmap. See
+ * roaring_bitmap_and_range.
+ */
+roaring_bitmap_t *roaring_bitmap_or_range(const roaring_bitmap_t *r1,
+                                          const roaring_bitmap_t *r2,
+                                          uint64_t range_start,
+                                          uint64_t range_end);
+
+/**
+ * Computes the difference (andnot) between two bitmaps restricted to the
+ * values in [range_start, range_end), and returns new bitmap. See
+ * roaring_bitmap_and_range.
+ */
+roaring_bitmap_t *roaring_bitmap_andnot_range(const roaring_bitmap_t *r1,
+                                              const roaring_bitmap_t *r2,
+                                              uint64_t range_start,
+                                              uint64_t range_end);
+
+/**
+ * Computes the size of the intersection between two bitmaps, counting only
+ * the values in [range_start, range_end).
+ */
+uint64_t roaring_bitmap_and_cardinality_range(const roaring_bitmap_t *r1,
+                                              const roaring_bitmap_t *r2,
+                                              uint64_t range_start,
+                                              uint64_t range_end);
+
+/**
+ * Computes the size of the union between two bitmaps, counting only the
+ * values in [range_start, range_end).
+ */
+uint64_t roaring_bitmap_or_cardinality_range(const roaring_bitmap_t *r1,
+                                             const roaring_bitmap_t *r2,
+                                             uint64_t range_start,
+                                             uint64_t range_end);
+
+/**
+ * Computes the size of the difference (andnot) between two bitmaps, counting
+ * only the values in [range_start, range_end).
+ */
+uint64_t roaring_bitmap_andnot_cardinality_range(const roaring_bitmap_t *r1,
+                                                 const roaring_bitmap_t *r2,
+                                                 uint64_t range_start,
+                                                 uint64_t range_end);
+
 /**
 * Returns true if the bitmap is empty (cardinality is zero).
 */
@@ -482,6 +627,18 @@ bool roaring_bitmap_remove_run_compression(roaring_bitmap_t *r);
  */
 bool roaring_bitmap_run_optimize(roaring_bitmap_t *r);
 
+/**
+ * Same as roaring_bitmap_run_optimize(), then turn back into bitsets the
+ * dense run containers that would be slow for the given access pattern: those
+ * with more than `membership_max_runs` or `union_max_runs` runs, see
+ * roaring_perf_parameters_t. ROARING_ACCESS_SIZE picks the smallest containers
+ * like roaring_bitmap_run_optimize().
+ *
+ * Returns true if the result has at least one run container.
+ */
+bool roaring_bitmap_run_optimize_for(roaring_bitmap_t *r,
+                                     roaring_access_pattern_t pattern);
+
 /**
  * If needed, reallocate memory to shrink the memory usage.
  * Returns the number of bytes saved.
@@ -612,6 +769,165 @@ size_t roaring_bitmap_portable_size_in_bytes(const roaring_bitmap_t *r);
  */
 size_t roaring_bitmap_portable_serialize(const roaring_bitmap_t *r, char *buf);
 
+/**
+ * Same as roaring_bitmap_portable_size_in_bytes and
+ * roaring_bitmap_portable_serialize, for the bitmap made of the containers
+ * at indexes [begin, end) of 'r' only. Nothing is copied: a bitmap cut at
+ * container boundaries this way can be written piece by piece, in parallel,
+ * and each piece read back as a bitmap of its own.
+ */
+size_t roaring_bitmap_portable_size_in_bytes_range(const roaring_bitmap_t *r,
+                                                   int32_t begin, int32_t end);
+
+size_t roaring_bitmap_portable_serialize_range(const roaring_bitmap_t *r,
+                                               int32_t begin, int32_t end,
+                                               char *buf);
+
+/**
+ * How many bytes are required to serialize this bitmap in the packed format.
+ *
+ * The packed format is specific to this library. It is laid out like the
+ * portable one, but array and bitset containers are stored delta bitpacked
+ * (SIMD-BP128 style, decoded with SIMD) whenever that is smaller than their raw
+ * form: mid-density containers typically shrink by half or more. Containers
+ * are decoded to their usual form on deserialization.
+ */
+size_t roaring_bitmap_packed_size_in_bytes(const roaring_bitmap_t *r);
+
+/**
+ * Write the bitmap in the packed format to a buffer of at least
+ * `roaring_bitmap_packed_size_in_bytes(r)` bytes. Returns how many bytes were
+ * written, which matches that size.
+ *
+ * This function is endian-sensitive, like `roaring_bitmap_portable_serialize()`.
+ */
+size_t roaring_bitmap_packed_serialize(const roaring_bitmap_t *r, char *buf);
+
+/**
+ * How many bytes are required to serialize this bitmap in the compressed
+ * variant of the packed format.
+ *
+ * Meant for cold storage, the compressed variant additionally codes array and
+ * bitset containers as delta+varint values, and bitset containers as runs of
+ * empty, full and literal words, whenever that is smaller. Decoding these is
+ * slower than the bitpacked form but remains a byte loop or memset/memcpy
+ * runs. The output is read by `roaring_bitmap_packed_deserialize_safe()`.
+ */
+size_t roaring_bitmap_compressed_size_in_bytes(const roaring_bitmap_t *r);
+
+/**
+ * Write the bitmap in the compressed variant of the packed format to a buffer
+ * of at least `roaring_bitmap_compressed_size_in_bytes(r)` bytes. Returns how
+ * many bytes were written, which matches that size.
+ */
+size_t roaring_bitmap_compressed_serialize(const roaring_bitmap_t *r,
+                                           char *buf);
+
+/**
+ * Whether the buffer starts like a bitmap written by
+ * `roaring_bitmap_packed_serialize()`. The cookie cannot be mistaken for the
+ * one of the portable format, so readers can accept both.
+ */
+bool roaring_bitmap_is_packed_serialization(const char *buf, size_t maxbytes);
+
+/**
+ * Read a bitmap written by `roaring_bitmap_packed_serialize()`, reading no
+ * more than maxbytes bytes. Returns NULL if the buffer is truncated, is not in
+ * the packed format, or on allocation failure.
+ */
+roaring_bitmap_t *roaring_bitmap_packed_deserialize_safe(const char *buf,
+                                                         size_t maxbytes);
+
+/**
+ * CRC32C (Castagnoli) of len bytes, continuing from crc, which is 0 for a
+ * fresh checksum. Uses the crc32 instruction (SSE4.2, ARMv8 CRC) when the
+ * processor has it, and a lookup table otherwise.
+ */
+uint32_t roaring_crc32c(uint32_t crc, const void *buf, size_t len);
+
+/**
+ * How many bytes are required to serialize this bitmap in the checksummed
+ * format.
+ *
+ * The checksummed format is specific to this library. It stores containers
+ * in their usual form, behind a table giving the key, type, cardinality,
+ * offset, size and CRC32C of each one; the table itself is covered by a
+ * CRC32C in the header. It costs 16 bytes plus 20 bytes per container, and
+ * lets a reader catch corrupted payloads (bit flips), which the structural
+ * checks of `roaring_bitmap_portable_deserialize_safe()` cannot.
+ */
+size_t roaring_bitmap_checksummed_size_in_bytes(const roaring_bitmap_t *r);
+
+/**
+ * Write the bitmap in the checksummed format to a buffer of at least
+ * `roaring_bitmap_checksummed_size_in_bytes(r)` bytes. Returns how many bytes
+ * were written, which matches that size.
+ *
+ * This function is endian-sensitive, like `roaring_bitmap_portable_serialize()`.
+ */
+size_t roaring_bitmap_checksummed_serialize(const roaring_bitmap_t *r,
+                                            char *buf);
+
+/**
+ * Whether the buffer starts like a bitmap written by
+ * `roaring_bitmap_checksummed_serialize()`. The cookie cannot be mistaken for
+ * the ones of the portable and packed formats.
+ */
+bool roaring_bitmap_is_checksummed_serialization(const char *buf,
+                                                 size_t maxbytes);
+
+/**
+ * Read a bitmap written by `roaring_bitmap_checksummed_serialize()`, reading
+ * no more than maxbytes bytes, after checking every checksum. Returns NULL if
+ * the buffer is truncated or corrupted, is not in the checksummed format, or
+ * on allocation failure.
+ */
+roaring_bitmap_t *roaring_bitmap_checksummed_deserialize_safe(const char *buf,
+                                                              size_t maxbytes);
+
+/**
+ * A bitmap in the checksummed format, read in place, for readers that only
+ * touch some of its containers and should only pay for checking those.
+ * The buffer must outlive the view.
+ */
+typedef struct roaring_checksummed_view_s {
+    const char *buf;
+    size_t bytes;          // size of the serialization
+    int32_t size;          // number of containers
+    uint64_t cardinality;
+} roaring_checksummed_view_t;
+
+/**
+ * Set up a view of a bitmap written by
+ * `roaring_bitmap_checksummed_serialize()`, reading no more than maxbytes
+ * bytes. Checks the header checksum and the table, so that the containers
+ * may then be looked up safely, but not the payloads: call
+ * `roaring_checksummed_view_verify()` on a container before trusting it.
+ * Returns false if the buffer is truncated or corrupted.
+ */
+bool roaring_checksummed_view_init(roaring_checksummed_view_t *v,
+                                   const char *buf, size_t maxbytes);
+
+/**
+ * Index of the container with the given key (high 16 bits), or a negative
+ * value if there is none.
+ */
+int32_t roaring_checksummed_view_find(const roaring_checksummed_view_t *v,
+                                      uint16_t key);
+
+/**
+ * Whether the payload of container i matches its checksum.
+ */
+bool roaring_checksummed_view_verify(const roaring_checksummed_view_t *v,
+                                     int32_t i);
+
+/**
+ * Whether container i holds the value with the given low 16 bits. Reads the
+ * payload in place, without checking it.
+ */
+bool roaring_checksummed_view_contains(const roaring_checksummed_view_t *v,
+                                       int32_t i, uint16_t low);
+
 /*
  * "Frozen" serialization format imitates memory layout of roaring_bitmap_t.
  * Deserialized bitmap is a constant view of the underlying buffer.
@@ -808,6 +1124,58 @@ uint64_t roaring_bitmap_rank(const roaring_bitmap_t *r, uint32_t x);
  */
 int64_t roaring_bitmap_get_index(const roaring_bitmap_t *r, uint32_t x);
 
+/**
+ * Cumulative counts over a bitmap that speed up rank, select and get_index:
+ * the number of values preceding each container, and for bitset containers
+ * the number of values preceding each of their 512-bit blocks. With it these
+ * queries cost a binary search over the containers plus a small constant
+ * amount of work within a bitset or array container (run containers are
+ * still scanned).
+ *
+ * Like roaring_bulk_context_t, the index is only valid for the bitmap it was
+ * built from and as long as that bitmap is not modified. Rebuild it with
+ * roaring_rank_index_init after a modification.
+ */
+typedef struct roaring_rank_index_s {
+    int32_t size;           // number of containers indexed
+    uint64_t *cumulative;   // values in containers [0, i), size + 1 entries
+    uint32_t *block_start;  // offset of a container's counts in blocks
+    uint16_t *blocks;       // counts per block of the bitset containers
+} roaring_rank_index_t;
+
+/**
+ * Build the index of `r` in `index`, which must not hold an index already.
+ * Returns false on allocation failure, leaving `index` empty.
+ */
+bool roaring_rank_index_init(roaring_rank_index_t *index,
+                             const roaring_bitmap_t *r);
+
+/**
+ * Release the memory held by `index`, leaving it empty.
+ */
+void roaring_rank_index_clear(roaring_rank_index_t *index);
+
+/**
+ * Same as roaring_bitmap_rank, using an up-to-date index of `r`.
+ */
+uint64_t roaring_bitmap_rank_indexed(const roaring_bitmap_t *r,
+                                     const roaring_rank_index_t *index,
+                                     uint32_t x);
+
+/**
+ * Same as roaring_bitmap_select, using an up-to-date index of `r`.
+ */
+bool roaring_bitmap_select_indexed(const roaring_bitmap_t *r,
+                                   const roaring_rank_index_t *index,
+                                   uint32_t rank, uint32_t *element);
+
+/**
+ * Same as roaring_bitmap_get_index, using an up-to-date index of `r`.
+ */
+int64_t roaring_bitmap_get_index_indexed(const roaring_bitmap_t *r,
+                                         const roaring_rank_index_t *index,
+                                         uint32_t x);
+
 /**
  * Returns the smallest value in the set, or UINT32_MAX if the set is empty.
  */
@@ -827,6 +1195,79 @@ uint32_t roaring_bitmap_maximum(const roaring_bitmap_t *r);
 void roaring_bitmap_statistics(const roaring_bitmap_t *r,
                                roaring_statistics_t *stat);
 
+/**
+ * (For advanced users.)
+ * Read the container conversion thresholds used by every bitmap, see
+ * roaring_perf_parameters_t.
+ */
+void roaring_get_perf_parameters(roaring_perf_parameters_t *params);
+
+/**
+ * (For advanced users.)
+ * Replace the container conversion thresholds used by every bitmap. They only
+ * decide which container types operations produce, never their results, but
+ * they are read without synchronization: set them before the bitmaps are
+ * shared between threads, typically at startup.
+ */
+void roaring_set_perf_parameters(const roaring_perf_parameters_t *params);
+
+/**
+ * (For advanced users.)
+ * Read the operation counts gathered since the last roaring_profile_reset()
+ * while the `profile` parameter was on. Counting is thread-safe.
+ */
+void roaring_profile_get(roaring_profile_t *profile);
+
+/**
+ * (For advanced users.)
+ * Reset the operation counts to zero.
+ */
+void roaring_profile_reset(void);
+
+/**
+ * (For advanced users.)
+ * Adjust the thresholds in `params`, typically the current ones, to the
+ * workload described by `profile`, and return the access pattern it is
+ * dominated by, to pass to roaring_bitmap_run_optimize_for().
+ *
+ *     roaring_perf_parameters_t params;
+ *     roaring_get_perf_parameters(&params);
+ *     params.profile = true;
+ *     roaring_set_perf_parameters(&params);
+ *     ... run a representative workload ...
+ *     roaring_profile_t profile;
+ *     roaring_profile_get(&profile);
+ *     roaring_access_pattern_t pattern =
+ *         roaring_profile_suggest(&profile, &params);
+ *     params.profile = false;
+ *     roaring_set_perf_parameters(&params);
+ */
+roaring_access_pattern_t roaring_profile_suggest(
+    const roaring_profile_t *profile, roaring_perf_parameters_t *params);
+
+/**
+ * (For advanced users.)
+ * Whether the library was built with CROARING_STATS, which compiles in the
+ * counters read by roaring_op_stats_get(). Without it they stay at zero.
+ */
+bool roaring_op_stats_enabled(void);
+
+/**
+ * (For advanced users.)
+ * Read the process-wide counts of container operations by pair of container
+ * types, of container conversions, of copies of shared containers and of
+ * allocations, gathered since the last roaring_op_stats_reset(). The counts
+ * are updated atomically but read one by one: a snapshot taken while other
+ * threads work is not exactly consistent.
+ */
+void roaring_op_stats_get(roaring_op_stats_t *stats);
+
+/**
+ * (For advanced users.)
+ * Reset the counts read by roaring_op_stats_get() to zero.
+ */
+void roaring_op_stats_reset(void);
+
 /*********************
 * What follows is code use to iterate through values in a roaring bitmap
 
@@ -936,6 +1377,29 @@ void roaring_free_uint32_iterator(roaring_uint32_iterator_t *it);
 uint32_t roaring_read_uint32_iterator(roaring_uint32_iterator_t *it,
                                       uint32_t* buf, uint32_t count);
 
+/**
+ * Move the iterator forward to the first value >= `val`, like
+ * `roaring_move_uint32_iterator_equalorlarger()`, but never backward: if the
+ * current value is already >= `val` the iterator is left unchanged. The search
+ * gallops from the current position, within the container and then over the
+ * following keys, so that a sequence of increasing targets costs time
+ * logarithmic in the distances skipped. Returns `it->has_value`.
+ */
+bool roaring_skip_uint32_iterator_to(roaring_uint32_iterator_t *it,
+                                     uint32_t val);
+
+/*
+ * Reads the current value and up to ${count} - 1 values preceding it into
+ * ${buf}, in decreasing order. Returns the number of read elements; a number
+ * smaller than ${count} means that the iterator is drained.
+ *
+ * This is the batched counterpart of `roaring_previous_uint32_iterator()`:
+ * after the function returns, the iterator is positioned at the largest value
+ * that was not read.
+ */
+uint32_t roaring_read_previous_uint32_iterator(roaring_uint32_iterator_t *it,
+                                               uint32_t* buf, uint32_t count);
+
 #ifdef __cplusplus
 } } }  // extern "C" { namespace roaring { namespace api {
 #endif
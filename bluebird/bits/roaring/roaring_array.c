@@ -129,8 +129,10 @@ bool ra_overwrite(const roaring_array_t *source, roaring_array_t *dest,
     // we go through the containers, turning them into shared containers...
     if (copy_on_write) {
         for (int32_t i = 0; i < dest->size; ++i) {
-            source->containers[i] = get_copy_of_container(
-                source->containers[i], &source->typecodes[i], copy_on_write);
+            uint8_t type = source->typecodes[i];
+            container_t *c = get_copy_of_container(source->containers[i],
+                                                   &type, copy_on_write);
+            ra_set_container_at_index(source, i, c, type);
         }
         // we do a shallow copy to the other bitmap
         memcpy(dest->containers, source->containers,
@@ -219,10 +221,12 @@ void ra_append_copy(roaring_array_t *ra, const roaring_array_t *sa,
     ra->keys[pos] = sa->keys[index];
     // the shared container will be in two bitmaps
     if (copy_on_write) {
-        sa->containers[index] = get_copy_of_container(
-            sa->containers[index], &sa->typecodes[index], copy_on_write);
-        ra->containers[pos] = sa->containers[index];
-        ra->typecodes[pos] = sa->typecodes[index];
+        uint8_t type = sa->typecodes[index];
+        container_t *c = get_copy_of_container(sa->containers[index], &type,
+                                               copy_on_write);
+        ra_set_container_at_index(sa, index, c, type);
+        ra->containers[pos] = c;
+        ra->typecodes[pos] = type;
     } else {
         ra->containers[pos] =
             container_clone(sa->containers[index], sa->typecodes[index]);
@@ -247,10 +251,12 @@ void ra_append_copy_range(roaring_array_t *ra, const roaring_array_t *sa,
         const int32_t pos = ra->size;
         ra->keys[pos] = sa->keys[i];
         if (copy_on_write) {
-            sa->containers[i] = get_copy_of_container(
-                sa->containers[i], &sa->typecodes[i], copy_on_write);
-            ra->containers[pos] = sa->containers[i];
-            ra->typecodes[pos] = sa->typecodes[i];
+            uint8_t type = sa->typecodes[i];
+            container_t *c = get_copy_of_container(sa->containers[i], &type,
+                                                   copy_on_write);
+            ra_set_container_at_index(sa, i, c, type);
+            ra->containers[pos] = c;
+            ra->typecodes[pos] = type;
         } else {
             ra->containers[pos] =
                 container_clone(sa->containers[i], sa->typecodes[i]);
@@ -293,10 +299,12 @@ void ra_append_range(roaring_array_t *ra, roaring_array_t *sa,
         const int32_t pos = ra->size;
         ra->keys[pos] = sa->keys[i];
         if (copy_on_write) {
-            sa->containers[i] = get_copy_of_container(
-                sa->containers[i], &sa->typecodes[i], copy_on_write);
-            ra->containers[pos] = sa->containers[i];
-            ra->typecodes[pos] = sa->typecodes[i];
+            uint8_t type = sa->typecodes[i];
+            container_t *c = get_copy_of_container(sa->containers[i], &type,
+                                                   copy_on_write);
+            ra_set_container_at_index(sa, i, c, type);
+            ra->containers[pos] = c;
+            ra->typecodes[pos] = type;
         } else {
             ra->containers[pos] =
                 container_clone(sa->containers[i], sa->typecodes[i]);
@@ -21,6 +21,8 @@ enum {
     SERIAL_COOKIE_NO_RUNCONTAINER = 12346,
     SERIAL_COOKIE = 12347,
     FROZEN_COOKIE = 13766,
+    PACKED_SERIAL_COOKIE = 13767,
+    CHECKSUM_SERIAL_COOKIE = 13768,
     NO_OFFSET_THRESHOLD = 4
 };
 
@@ -158,14 +160,20 @@ void ra_append_range(roaring_array_t *ra, roaring_array_t *sa,
 /**
  * Set the container at the corresponding index using the specified
  * typecode.
+ *
+ * Stores that change nothing are skipped: sharing the already shared
+ * containers of a copy-on-write bitmap then only reads it, so that several
+ * threads may use the same bitmap as the source of copies and operations.
  */
 inline void ra_set_container_at_index(
     const roaring_array_t *ra, int32_t i,
     container_t *c, uint8_t typecode
 ){
     assert(i < ra->size);
-    ra->containers[i] = c;
-    ra->typecodes[i] = typecode;
+    if (ra->containers[i] != c || ra->typecodes[i] != typecode) {
+        ra->containers[i] = c;
+        ra->typecodes[i] = typecode;
+    }
 }
 
 container_t *ra_get_container(roaring_array_t *ra, uint16_t x, uint8_t *typecode);
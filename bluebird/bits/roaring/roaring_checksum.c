@@ -0,0 +1,454 @@
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "roaring.h"
+#include "roaring_array.h"
+#include "isadetection.h"
+
+#include "bluebird/bits/roaring/containers/containers.h"
+
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#ifdef __cplusplus
+using namespace ::roaring::internal;
+
+extern "C" { namespace roaring { namespace api {
+#endif
+
+/*
+ * Layout of the checksummed serialization:
+ *
+ *   uint32_t cookie                 CHECKSUM_SERIAL_COOKIE
+ *   uint32_t size                   number of containers
+ *   uint32_t bytes                  size of the whole serialization
+ *   uint32_t header checksum        CRC32C of the three fields above and of
+ *                                   the table
+ *   size x {                        the table, in key order
+ *       uint16_t key
+ *       uint8_t  type               ARRAY, BITSET or RUN_CONTAINER_TYPE
+ *       uint8_t  reserved           0
+ *       uint32_t cardinality
+ *       uint32_t offset             of the payload from the start
+ *       uint32_t payload bytes
+ *       uint32_t payload checksum   CRC32C of the payload
+ *   }
+ *   payloads, one per container, in key order, back to back
+ *
+ * Payloads are the raw values of an array container, the 1024 words of a
+ * bitset container, or the value/length pairs of a run container.
+ *
+ * A reader checks the header checksum and the table up front, which is all
+ * it needs to find any container, and each payload checksum only when it
+ * first touches that container: see roaring_checksummed_view_init().
+ */
+
+#define CHECKSUM_HEADER_BYTES (4 * sizeof(uint32_t))
+#define CHECKSUM_ENTRY_BYTES (2 * sizeof(uint16_t) + 4 * sizeof(uint32_t))
+#define CHECKSUM_TABLE_BYTES(size) \
+    (CHECKSUM_HEADER_BYTES + (size_t)(size) * CHECKSUM_ENTRY_BYTES)
+
+#define BITSET_BYTES (BITSET_CONTAINER_SIZE_IN_WORDS * sizeof(uint64_t))
+
+/* CRC32C (Castagnoli), reflected polynomial 0x82F63B78. */
+static const uint32_t crc32c_table[256] = {
+    0x00000000, 0xF26B8303, 0xE13B70F7, 0x1350F3F4, 0xC79A971F, 0x35F1141C,
+    0x26A1E7E8, 0xD4CA64EB, 0x8AD958CF, 0x78B2DBCC, 0x6BE22838, 0x9989AB3B,
+    0x4D43CFD0, 0xBF284CD3, 0xAC78BF27, 0x5E133C24, 0x105EC76F, 0xE235446C,
+    0xF165B798, 0x030E349B, 0xD7C45070, 0x25AFD373, 0x36FF2087, 0xC494A384,
+    0x9A879FA0, 0x68EC1CA3, 0x7BBCEF57, 0x89D76C54, 0x5D1D08BF, 0xAF768BBC,
+    0xBC267848, 0x4E4DFB4B, 0x20BD8EDE, 0xD2D60DDD, 0xC186FE29, 0x33ED7D2A,
+    0xE72719C1, 0x154C9AC2, 0x061C6936, 0xF477EA35, 0xAA64D611, 0x580F5512,
+    0x4B5FA6E6, 0xB93425E5, 0x6DFE410E, 0x9F95C20D, 0x8CC531F9, 0x7EAEB2FA,
+    0x30E349B1, 0xC288CAB2, 0xD1D83946, 0x23B3BA45, 0xF779DEAE, 0x05125DAD,
+    0x1642AE59, 0xE4292D5A, 0xBA3A117E, 0x4851927D, 0x5B016189, 0xA96AE28A,
+    0x7DA08661, 0x8FCB0562, 0x9C9BF696, 0x6EF07595, 0x417B1DBC, 0xB3109EBF,
+    0xA0406D4B, 0x522BEE48, 0x86E18AA3, 0x748A09A0, 0x67DAFA54, 0x95B17957,
+    0xCBA24573, 0x39C9C670, 0x2A993584, 0xD8F2B687, 0x0C38D26C, 0xFE53516F,
+    0xED03A29B, 0x1F682198, 0x5125DAD3, 0xA34E59D0, 0xB01EAA24, 0x42752927,
+    0x96BF4DCC, 0x64D4CECF, 0x77843D3B, 0x85EFBE38, 0xDBFC821C, 0x2997011F,
+    0x3AC7F2EB, 0xC8AC71E8, 0x1C661503, 0xEE0D9600, 0xFD5D65F4, 0x0F36E6F7,
+    0x61C69362, 0x93AD1061, 0x80FDE395, 0x72966096, 0xA65C047D, 0x5437877E,
+    0x4767748A, 0xB50CF789, 0xEB1FCBAD, 0x197448AE, 0x0A24BB5A, 0xF84F3859,
+    0x2C855CB2, 0xDEEEDFB1, 0xCDBE2C45, 0x3FD5AF46, 0x7198540D, 0x83F3D70E,
+    0x90A324FA, 0x62C8A7F9, 0xB602C312, 0x44694011, 0x5739B3E5, 0xA55230E6,
+    0xFB410CC2, 0x092A8FC1, 0x1A7A7C35, 0xE811FF36, 0x3CDB9BDD, 0xCEB018DE,
+    0xDDE0EB2A, 0x2F8B6829, 0x82F63B78, 0x709DB87B, 0x63CD4B8F, 0x91A6C88C,
+    0x456CAC67, 0xB7072F64, 0xA457DC90, 0x563C5F93, 0x082F63B7, 0xFA44E0B4,
+    0xE9141340, 0x1B7F9043, 0xCFB5F4A8, 0x3DDE77AB, 0x2E8E845F, 0xDCE5075C,
+    0x92A8FC17, 0x60C37F14, 0x73938CE0, 0x81F80FE3, 0x55326B08, 0xA759E80B,
+    0xB4091BFF, 0x466298FC, 0x1871A4D8, 0xEA1A27DB, 0xF94AD42F, 0x0B21572C,
+    0xDFEB33C7, 0x2D80B0C4, 0x3ED04330, 0xCCBBC033, 0xA24BB5A6, 0x502036A5,
+    0x4370C551, 0xB11B4652, 0x65D122B9, 0x97BAA1BA, 0x84EA524E, 0x7681D14D,
+    0x2892ED69, 0xDAF96E6A, 0xC9A99D9E, 0x3BC21E9D, 0xEF087A76, 0x1D63F975,
+    0x0E330A81, 0xFC588982, 0xB21572C9, 0x407EF1CA, 0x532E023E, 0xA145813D,
+    0x758FE5D6, 0x87E466D5, 0x94B49521, 0x66DF1622, 0x38CC2A06, 0xCAA7A905,
+    0xD9F75AF1, 0x2B9CD9F2, 0xFF56BD19, 0x0D3D3E1A, 0x1E6DCDEE, 0xEC064EED,
+    0xC38D26C4, 0x31E6A5C7, 0x22B65633, 0xD0DDD530, 0x0417B1DB, 0xF67C32D8,
+    0xE52CC12C, 0x1747422F, 0x49547E0B, 0xBB3FFD08, 0xA86F0EFC, 0x5A048DFF,
+    0x8ECEE914, 0x7CA56A17, 0x6FF599E3, 0x9D9E1AE0, 0xD3D3E1AB, 0x21B862A8,
+    0x32E8915C, 0xC083125F, 0x144976B4, 0xE622F5B7, 0xF5720643, 0x07198540,
+    0x590AB964, 0xAB613A67, 0xB831C993, 0x4A5A4A90, 0x9E902E7B, 0x6CFBAD78,
+    0x7FAB5E8C, 0x8DC0DD8F, 0xE330A81A, 0x115B2B19, 0x020BD8ED, 0xF0605BEE,
+    0x24AA3F05, 0xD6C1BC06, 0xC5914FF2, 0x37FACCF1, 0x69E9F0D5, 0x9B8273D6,
+    0x88D28022, 0x7AB90321, 0xAE7367CA, 0x5C18E4C9, 0x4F48173D, 0xBD23943E,
+    0xF36E6F75, 0x0105EC76, 0x12551F82, 0xE03E9C81, 0x34F4F86A, 0xC69F7B69,
+    0xD5CF889D, 0x27A40B9E, 0x79B737BA, 0x8BDCB4B9, 0x988C474D, 0x6AE7C44E,
+    0xBE2DA0A5, 0x4C4623A6, 0x5F16D052, 0xAD7D5351,
+};
+
+static uint32_t crc32c_software(uint32_t crc, const uint8_t *p, size_t len) {
+    while (len--) {
+        crc = crc32c_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#ifdef __cplusplus
+} } }  // extern "C" { namespace roaring { namespace api {
+#endif
+
+#if CROARING_IS_X64
+/* The crc32 instruction is part of SSE4.2, which every processor with AVX2
+ * has. */
+CROARING_TARGET_REGION("sse4.2")
+static uint32_t crc32c_sse42(uint32_t crc, const uint8_t *p, size_t len) {
+    uint64_t c = crc;
+    while (len >= sizeof(uint64_t)) {
+        uint64_t w;
+        memcpy(&w, p, sizeof(w));
+        c = _mm_crc32_u64(c, w);
+        p += sizeof(w);
+        len -= sizeof(w);
+    }
+    uint32_t c32 = (uint32_t)c;
+    while (len--) {
+        c32 = _mm_crc32_u8(c32, *p++);
+    }
+    return c32;
+}
+CROARING_UNTARGET_REGION
+#endif
+
+#ifdef __cplusplus
+extern "C" { namespace roaring { namespace api {
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+static uint32_t crc32c_arm(uint32_t crc, const uint8_t *p, size_t len) {
+    while (len >= sizeof(uint64_t)) {
+        uint64_t w;
+        memcpy(&w, p, sizeof(w));
+        crc = __crc32cd(crc, w);
+        p += sizeof(w);
+        len -= sizeof(w);
+    }
+    while (len--) {
+        crc = __crc32cb(crc, *p++);
+    }
+    return crc;
+}
+#endif
+
+uint32_t roaring_crc32c(uint32_t crc, const void *buf, size_t len) {
+    const uint8_t *p = (const uint8_t *)buf;
+    crc = ~crc;
+#if CROARING_IS_X64
+    if (croaring_hardware_support() & ROARING_SUPPORTS_AVX2) {
+        return ~crc32c_sse42(crc, p, len);
+    }
+#elif defined(__ARM_FEATURE_CRC32)
+    return ~crc32c_arm(crc, p, len);
+#endif
+    return ~crc32c_software(crc, p, len);
+}
+
+static size_t checksum_payload_bytes(const container_t *c, uint8_t type) {
+    switch (type) {
+        case ARRAY_CONTAINER_TYPE:
+            return const_CAST_array(c)->cardinality * sizeof(uint16_t);
+        case BITSET_CONTAINER_TYPE:
+            return BITSET_BYTES;
+        default:
+            return const_CAST_run(c)->n_runs * sizeof(rle16_t);
+    }
+}
+
+static const void *checksum_payload(const container_t *c, uint8_t type) {
+    switch (type) {
+        case ARRAY_CONTAINER_TYPE:
+            return const_CAST_array(c)->array;
+        case BITSET_CONTAINER_TYPE:
+            return const_CAST_bitset(c)->words;
+        default:
+            return const_CAST_run(c)->runs;
+    }
+}
+
+size_t roaring_bitmap_checksummed_size_in_bytes(const roaring_bitmap_t *r) {
+    const roaring_array_t *ra = &r->high_low_container;
+    size_t bytes = CHECKSUM_TABLE_BYTES(ra->size);
+    for (int32_t i = 0; i < ra->size; i++) {
+        uint8_t type = ra->typecodes[i];
+        const container_t *c = container_unwrap_shared(ra->containers[i], &type);
+        bytes += checksum_payload_bytes(c, type);
+    }
+    return bytes;
+}
+
+size_t roaring_bitmap_checksummed_serialize(const roaring_bitmap_t *r,
+                                            char *buf) {
+    const roaring_array_t *ra = &r->high_low_container;
+    uint8_t *out = (uint8_t *)buf;
+    uint8_t *entry = out + CHECKSUM_HEADER_BYTES;
+    uint32_t offset = (uint32_t)CHECKSUM_TABLE_BYTES(ra->size);
+    for (int32_t i = 0; i < ra->size; i++) {
+        uint8_t type = ra->typecodes[i];
+        const container_t *c = container_unwrap_shared(ra->containers[i], &type);
+        const uint32_t card = (uint32_t)container_get_cardinality(c, type);
+        const uint32_t bytes = (uint32_t)checksum_payload_bytes(c, type);
+        const uint32_t crc = roaring_crc32c(0, checksum_payload(c, type), bytes);
+        const uint8_t reserved = 0;
+        memcpy(entry, &ra->keys[i], sizeof(uint16_t));
+        memcpy(entry + 2, &type, sizeof(type));
+        memcpy(entry + 3, &reserved, sizeof(reserved));
+        memcpy(entry + 4, &card, sizeof(card));
+        memcpy(entry + 8, &offset, sizeof(offset));
+        memcpy(entry + 12, &bytes, sizeof(bytes));
+        memcpy(entry + 16, &crc, sizeof(crc));
+        memcpy(out + offset, checksum_payload(c, type), bytes);
+        entry += CHECKSUM_ENTRY_BYTES;
+        offset += bytes;
+    }
+    const uint32_t cookie = CHECKSUM_SERIAL_COOKIE;
+    const uint32_t size = (uint32_t)ra->size;
+    memcpy(out, &cookie, sizeof(cookie));
+    memcpy(out + 4, &size, sizeof(size));
+    memcpy(out + 8, &offset, sizeof(offset));
+    uint32_t crc = roaring_crc32c(0, out, 3 * sizeof(uint32_t));
+    crc = roaring_crc32c(crc, out + CHECKSUM_HEADER_BYTES,
+                         (size_t)size * CHECKSUM_ENTRY_BYTES);
+    memcpy(out + 12, &crc, sizeof(crc));
+    return offset;
+}
+
+bool roaring_bitmap_is_checksummed_serialization(const char *buf,
+                                                 size_t maxbytes) {
+    uint32_t cookie;
+    if (maxbytes < sizeof(cookie)) {
+        return false;
+    }
+    memcpy(&cookie, buf, sizeof(cookie));
+    return cookie == CHECKSUM_SERIAL_COOKIE;
+}
+
+typedef struct checksum_entry_s {
+    uint16_t key;
+    uint8_t type;
+    uint32_t cardinality;
+    uint32_t offset;
+    uint32_t bytes;
+    uint32_t crc;
+} checksum_entry_t;
+
+static void checksum_read_entry(const roaring_checksummed_view_t *v, int32_t i,
+                                checksum_entry_t *e) {
+    const char *entry = v->buf + CHECKSUM_TABLE_BYTES(i);
+    memcpy(&e->key, entry, sizeof(e->key));
+    memcpy(&e->type, entry + 2, sizeof(e->type));
+    memcpy(&e->cardinality, entry + 4, sizeof(e->cardinality));
+    memcpy(&e->offset, entry + 8, sizeof(e->offset));
+    memcpy(&e->bytes, entry + 12, sizeof(e->bytes));
+    memcpy(&e->crc, entry + 16, sizeof(e->crc));
+}
+
+/* Whether the payload size agrees with the type and cardinality. */
+static bool checksum_entry_valid(const checksum_entry_t *e) {
+    switch (e->type) {
+        case ARRAY_CONTAINER_TYPE:
+            return e->cardinality >= 1 &&
+                   e->cardinality <= DEFAULT_MAX_SIZE &&
+                   e->bytes == e->cardinality * sizeof(uint16_t);
+        case BITSET_CONTAINER_TYPE:
+            return e->cardinality >= 1 && e->cardinality <= (1 << 16) &&
+                   e->bytes == BITSET_BYTES;
+        case RUN_CONTAINER_TYPE:
+            return e->cardinality >= 1 && e->cardinality <= (1 << 16) &&
+                   e->bytes >= sizeof(rle16_t) &&
+                   e->bytes <= (1 << 15) * sizeof(rle16_t) &&
+                   e->bytes % sizeof(rle16_t) == 0;
+        default:
+            return false;
+    }
+}
+
+bool roaring_checksummed_view_init(roaring_checksummed_view_t *v,
+                                   const char *buf, size_t maxbytes) {
+    if (!roaring_bitmap_is_checksummed_serialization(buf, maxbytes) ||
+        maxbytes < CHECKSUM_HEADER_BYTES) {
+        return false;
+    }
+    uint32_t size, bytes, crc;
+    memcpy(&size, buf + 4, sizeof(size));
+    memcpy(&bytes, buf + 8, sizeof(bytes));
+    memcpy(&crc, buf + 12, sizeof(crc));
+    if (size > (1 << 16) || bytes > maxbytes ||
+        CHECKSUM_TABLE_BYTES(size) > bytes) {
+        return false;
+    }
+    uint32_t actual = roaring_crc32c(0, buf, 3 * sizeof(uint32_t));
+    actual = roaring_crc32c(actual, buf + CHECKSUM_HEADER_BYTES,
+                            (size_t)size * CHECKSUM_ENTRY_BYTES);
+    if (actual != crc) {
+        return false;
+    }
+    v->buf = buf;
+    v->bytes = bytes;
+    v->size = (int32_t)size;
+    v->cardinality = 0;
+    // payloads are back to back, so every one of them lies within the buffer
+    uint32_t offset = (uint32_t)CHECKSUM_TABLE_BYTES(size);
+    for (int32_t i = 0; i < v->size; i++) {
+        checksum_entry_t e, prev;
+        checksum_read_entry(v, i, &e);
+        if (!checksum_entry_valid(&e) || e.offset != offset ||
+            e.bytes > bytes - offset) {
+            return false;
+        }
+        if (i > 0) {
+            checksum_read_entry(v, i - 1, &prev);
+            if (e.key <= prev.key) {
+                return false;
+            }
+        }
+        offset += e.bytes;
+        v->cardinality += e.cardinality;
+    }
+    return offset == bytes;
+}
+
+int32_t roaring_checksummed_view_find(const roaring_checksummed_view_t *v,
+                                      uint16_t key) {
+    int32_t low = 0;
+    int32_t high = v->size - 1;
+    while (low <= high) {
+        const int32_t middle = (low + high) >> 1;
+        uint16_t k;
+        memcpy(&k, v->buf + CHECKSUM_TABLE_BYTES(middle), sizeof(k));
+        if (k < key) {
+            low = middle + 1;
+        } else if (k > key) {
+            high = middle - 1;
+        } else {
+            return middle;
+        }
+    }
+    return -(low + 1);
+}
+
+bool roaring_checksummed_view_verify(const roaring_checksummed_view_t *v,
+                                     int32_t i) {
+    checksum_entry_t e;
+    checksum_read_entry(v, i, &e);
+    return roaring_crc32c(0, v->buf + e.offset, e.bytes) == e.crc;
+}
+
+bool roaring_checksummed_view_contains(const roaring_checksummed_view_t *v,
+                                       int32_t i, uint16_t low) {
+    checksum_entry_t e;
+    checksum_read_entry(v, i, &e);
+    const char *payload = v->buf + e.offset;
+    if (e.type == BITSET_CONTAINER_TYPE) {
+        uint8_t byte;
+        memcpy(&byte, payload + (low >> 3), sizeof(byte));
+        return (byte >> (low & 7)) & 1;
+    }
+    // binary search on the values, or on the run starts
+    const size_t stride = e.type == ARRAY_CONTAINER_TYPE ? sizeof(uint16_t)
+                                                         : sizeof(rle16_t);
+    int32_t lo = 0;
+    int32_t hi = (int32_t)(e.bytes / stride) - 1;
+    while (lo <= hi) {
+        const int32_t middle = (lo + hi) >> 1;
+        uint16_t value;
+        memcpy(&value, payload + middle * stride, sizeof(value));
+        if (value < low) {
+            lo = middle + 1;
+        } else if (value > low) {
+            hi = middle - 1;
+        } else {
+            return true;
+        }
+    }
+    if (e.type == ARRAY_CONTAINER_TYPE || hi < 0) {
+        return false;
+    }
+    rle16_t run;
+    memcpy(&run, payload + hi * stride, sizeof(run));
+    return low - run.value <= run.length;
+}
+
+/* Container holding the payload of entry e, or NULL. */
+static container_t *checksum_read_container(const char *payload,
+                                            const checksum_entry_t *e) {
+    switch (e->type) {
+        case ARRAY_CONTAINER_TYPE: {
+            array_container_t *ac =
+                    array_container_create_given_capacity((int32_t)e->cardinality);
+            if (ac != NULL) {
+                memcpy(ac->array, payload, e->bytes);
+                ac->cardinality = (int32_t)e->cardinality;
+            }
+            return ac;
+        }
+        case BITSET_CONTAINER_TYPE: {
+            bitset_container_t *bc = bitset_container_create();
+            if (bc != NULL) {
+                memcpy(bc->words, payload, e->bytes);
+                bc->cardinality = (int32_t)e->cardinality;
+            }
+            return bc;
+        }
+        default: {
+            const int32_t n_runs = (int32_t)(e->bytes / sizeof(rle16_t));
+            run_container_t *rc = run_container_create_given_capacity(n_runs);
+            if (rc != NULL) {
+                memcpy(rc->runs, payload, e->bytes);
+                rc->n_runs = n_runs;
+            }
+            return rc;
+        }
+    }
+}
+
+roaring_bitmap_t *roaring_bitmap_checksummed_deserialize_safe(const char *buf,
+                                                              size_t maxbytes) {
+    roaring_checksummed_view_t v;
+    if (!roaring_checksummed_view_init(&v, buf, maxbytes)) {
+        return NULL;
+    }
+    roaring_bitmap_t *r = roaring_bitmap_create_with_capacity(v.size);
+    if (r == NULL) {
+        return NULL;
+    }
+    for (int32_t i = 0; i < v.size; i++) {
+        checksum_entry_t e;
+        checksum_read_entry(&v, i, &e);
+        const char *payload = buf + e.offset;
+        container_t *c = roaring_crc32c(0, payload, e.bytes) == e.crc
+                                 ? checksum_read_container(payload, &e)
+                                 : NULL;
+        if (c == NULL) {
+            roaring_bitmap_free(r);
+            return NULL;
+        }
+        ra_append(&r->high_low_container, e.key, c, e.type);
+    }
+    return r;
+}
+
+#ifdef __cplusplus
+} } }  // extern "C" { namespace roaring { namespace api {
+#endif
@@ -0,0 +1,596 @@
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "roaring.h"
+#include "roaring_array.h"
+
+#include "bluebird/bits/roaring/containers/containers.h"
+#include "bluebird/bits/roaring/containers/packed.h"
+#include "bitset_util.h"
+
+#ifdef __cplusplus
+using namespace ::roaring::internal;
+
+extern "C" { namespace roaring { namespace api {
+#endif
+
+/*
+ * Layout of the packed serialization:
+ *
+ *   uint32_t cookie                 PACKED_SERIAL_COOKIE
+ *   uint32_t size                   number of containers
+ *   uint16_t keys[size]
+ *   uint16_t cardinalities[size]    cardinality - 1
+ *   uint8_t  kinds[size]            PACKED_KIND_* below
+ *   payloads, one per container, in key order
+ *
+ * Payloads are:
+ *   PACKED_KIND_ARRAY   the raw values
+ *   PACKED_KIND_BITSET  the 1024 raw words
+ *   PACKED_KIND_RUN     a uint16_t run count followed by value/length pairs
+ *   PACKED_KIND_DELTA   delta bitpacked values, as coded by containers/packed.h
+ *   PACKED_KIND_VARINT  the gaps minus one between values as LEB128 varints
+ *   PACKED_KIND_WORDS   the words of a bitset as groups of three varints,
+ *                       counting empty, full and literal words, followed by
+ *                       the literal words
+ *
+ * The packed writer stores each array and bitset container in the smaller of
+ * its raw and delta bitpacked forms, all of which decode with SIMD. The
+ * compressed writer, meant for cold storage, also considers the varint and
+ * word run codings: they decode with a byte loop, and with memset/memcpy
+ * runs, respectively. The reader accepts all of them.
+ */
+enum {
+    PACKED_KIND_ARRAY = 1,
+    PACKED_KIND_BITSET = 2,
+    PACKED_KIND_RUN = 3,
+    PACKED_KIND_DELTA = 4,
+    PACKED_KIND_VARINT = 5,
+    PACKED_KIND_WORDS = 6
+};
+
+#define PACKED_HEADER_BYTES(size) \
+    (2 * sizeof(uint32_t) + (size_t)(size) * (2 * sizeof(uint16_t) + 1))
+
+#define BITSET_BYTES (BITSET_CONTAINER_SIZE_IN_WORDS * sizeof(uint64_t))
+
+/* Hands out the values of an array or bitset container, PACKED_BLOCK_SIZE at
+ * a time. */
+typedef struct container_values_s {
+    const uint16_t *array;  // NULL for a bitset
+    int32_t remaining;
+    const uint64_t *words;
+    int32_t wordindex;
+    uint64_t word;
+    uint16_t block[PACKED_BLOCK_SIZE];
+} container_values_t;
+
+static void container_values_init(container_values_t *it, const container_t *c,
+                                  uint8_t type) {
+    if (type == ARRAY_CONTAINER_TYPE) {
+        const array_container_t *ac = const_CAST_array(c);
+        it->array = ac->array;
+        it->remaining = ac->cardinality;
+    } else {
+        const bitset_container_t *bc = const_CAST_bitset(c);
+        it->array = NULL;
+        it->words = bc->words;
+        it->wordindex = 0;
+        it->word = bc->words[0];
+    }
+}
+
+/* Point *values to the next block of values and return its size, 0 at the
+ * end. */
+static int32_t container_values_next(container_values_t *it,
+                                     const uint16_t **values) {
+    int32_t n = 0;
+    if (it->array != NULL) {
+        n = it->remaining < PACKED_BLOCK_SIZE ? it->remaining : PACKED_BLOCK_SIZE;
+        *values = it->array;
+        it->array += n;
+        it->remaining -= n;
+        return n;
+    }
+    while (n < PACKED_BLOCK_SIZE) {
+        while (it->word == 0) {
+            if (it->wordindex + 1 == BITSET_CONTAINER_SIZE_IN_WORDS) {
+                *values = it->block;
+                return n;
+            }
+            it->word = it->words[++it->wordindex];
+        }
+        it->block[n++] = (uint16_t)(it->wordindex * 64 +
+                                    roaring_trailing_zeroes(it->word));
+        it->word &= it->word - 1;
+    }
+    *values = it->block;
+    return n;
+}
+
+static inline size_t varint_size(uint32_t v) {
+    return v < (1 << 7) ? 1 : v < (1 << 14) ? 2 : 3;
+}
+
+static inline size_t varint_write(uint32_t v, uint8_t *out) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+/* Read a varint below 2^21; returns the bytes consumed, or 0 if it is
+ * truncated or longer. */
+static inline size_t varint_read(const uint8_t *in, size_t maxbytes,
+                                 uint32_t *v) {
+    uint32_t result = 0;
+    for (size_t n = 0; n < 3 && n < maxbytes; n++) {
+        result |= (uint32_t)(in[n] & 0x7F) << (7 * n);
+        if ((in[n] & 0x80) == 0) {
+            *v = result;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+/* Bytes of the delta bitpacked or varint coding of the values. */
+static size_t values_coded_size(const container_t *c, uint8_t type,
+                                uint8_t kind) {
+    container_values_t it;
+    container_values_init(&it, c, type);
+    const uint16_t *values;
+    size_t bytes = 0;
+    int32_t prev = -1;
+    int32_t n;
+    while ((n = container_values_next(&it, &values)) > 0) {
+        if (kind == PACKED_KIND_DELTA) {
+            bytes += packed_block_size(values, n, prev);
+        } else {
+            for (int32_t i = 0; i < n; i++) {
+                bytes += varint_size((uint32_t)(values[i] - prev - 1));
+                prev = values[i];
+            }
+        }
+        prev = values[n - 1];
+    }
+    return bytes;
+}
+
+static size_t values_write(const container_t *c, uint8_t type, uint8_t kind,
+                           uint8_t *out) {
+    container_values_t it;
+    container_values_init(&it, c, type);
+    const uint16_t *values;
+    size_t bytes = 0;
+    int32_t prev = -1;
+    int32_t n;
+    while ((n = container_values_next(&it, &values)) > 0) {
+        if (kind == PACKED_KIND_DELTA) {
+            bytes += packed_encode_block(values, n, prev, out + bytes);
+        } else {
+            for (int32_t i = 0; i < n; i++) {
+                bytes += varint_write((uint32_t)(values[i] - prev - 1),
+                                      out + bytes);
+                prev = values[i];
+            }
+        }
+        prev = values[n - 1];
+    }
+    return bytes;
+}
+
+/* Length of the run of words equal to w from index i on. */
+static inline uint32_t words_run(const uint64_t *words, uint32_t i,
+                                 uint64_t w) {
+    uint32_t n = 0;
+    while (i + n < BITSET_CONTAINER_SIZE_IN_WORDS && words[i + n] == w) {
+        n++;
+    }
+    return n;
+}
+
+/* Size of the PACKED_KIND_WORDS coding when out is NULL, else write it. */
+static size_t words_code(const bitset_container_t *bc, uint8_t *out) {
+    const uint64_t *words = bc->words;
+    size_t bytes = 0;
+    uint32_t i = 0;
+    while (i < BITSET_CONTAINER_SIZE_IN_WORDS) {
+        uint32_t empty = words_run(words, i, 0);
+        uint32_t full = words_run(words, i + empty, UINT64_MAX);
+        uint32_t j = i + empty + full;
+        uint32_t literal = 0;
+        while (j + literal < BITSET_CONTAINER_SIZE_IN_WORDS &&
+               words[j + literal] != 0 && words[j + literal] != UINT64_MAX) {
+            literal++;
+        }
+        if (out == NULL) {
+            bytes += varint_size(empty) + varint_size(full) +
+                     varint_size(literal) + literal * sizeof(uint64_t);
+        } else {
+            bytes += varint_write(empty, out + bytes);
+            bytes += varint_write(full, out + bytes);
+            bytes += varint_write(literal, out + bytes);
+            memcpy(out + bytes, words + j, literal * sizeof(uint64_t));
+            bytes += literal * sizeof(uint64_t);
+        }
+        i = j + literal;
+    }
+    return bytes;
+}
+
+/* Kind under which the container is written, and its payload size. */
+static uint8_t packed_kind(const container_t *c, uint8_t type, bool compress,
+                           size_t *payload) {
+    c = container_unwrap_shared(c, &type);
+    uint8_t kind;
+    switch (type) {
+        case BITSET_CONTAINER_TYPE:
+            kind = PACKED_KIND_BITSET;
+            *payload = BITSET_BYTES;
+            break;
+        case ARRAY_CONTAINER_TYPE:
+            kind = PACKED_KIND_ARRAY;
+            *payload = const_CAST_array(c)->cardinality * sizeof(uint16_t);
+            break;
+        case RUN_CONTAINER_TYPE:
+            *payload = sizeof(uint16_t) +
+                       const_CAST_run(c)->n_runs * sizeof(rle16_t);
+            return PACKED_KIND_RUN;
+        default:
+            assert(false);
+            roaring_unreachable;
+            return 0;
+    }
+    size_t bytes = values_coded_size(c, type, PACKED_KIND_DELTA);
+    if (bytes < *payload) {
+        kind = PACKED_KIND_DELTA;
+        *payload = bytes;
+    }
+    if (!compress) {
+        return kind;
+    }
+    bytes = values_coded_size(c, type, PACKED_KIND_VARINT);
+    if (bytes < *payload) {
+        kind = PACKED_KIND_VARINT;
+        *payload = bytes;
+    }
+    if (type == BITSET_CONTAINER_TYPE) {
+        bytes = words_code(const_CAST_bitset(c), NULL);
+        if (bytes < *payload) {
+            kind = PACKED_KIND_WORDS;
+            *payload = bytes;
+        }
+    }
+    return kind;
+}
+
+static size_t packed_write_payload(const container_t *c, uint8_t type,
+                                   uint8_t kind, uint8_t *out) {
+    c = container_unwrap_shared(c, &type);
+    switch (kind) {
+        case PACKED_KIND_BITSET:
+            memcpy(out, const_CAST_bitset(c)->words, BITSET_BYTES);
+            return BITSET_BYTES;
+        case PACKED_KIND_ARRAY: {
+            const array_container_t *ac = const_CAST_array(c);
+            memcpy(out, ac->array, ac->cardinality * sizeof(uint16_t));
+            return ac->cardinality * sizeof(uint16_t);
+        }
+        case PACKED_KIND_RUN: {
+            const run_container_t *rc = const_CAST_run(c);
+            uint16_t n_runs = (uint16_t)rc->n_runs;
+            memcpy(out, &n_runs, sizeof(n_runs));
+            memcpy(out + sizeof(n_runs), rc->runs, rc->n_runs * sizeof(rle16_t));
+            return sizeof(n_runs) + rc->n_runs * sizeof(rle16_t);
+        }
+        case PACKED_KIND_DELTA:
+        case PACKED_KIND_VARINT:
+            return values_write(c, type, kind, out);
+        case PACKED_KIND_WORDS:
+            return words_code(const_CAST_bitset(c), out);
+        default:
+            assert(false);
+            roaring_unreachable;
+            return 0;
+    }
+}
+
+static size_t packed_size_in_bytes(const roaring_bitmap_t *r, bool compress) {
+    const roaring_array_t *ra = &r->high_low_container;
+    size_t bytes = PACKED_HEADER_BYTES(ra->size);
+    for (int32_t i = 0; i < ra->size; i++) {
+        size_t payload;
+        packed_kind(ra->containers[i], ra->typecodes[i], compress, &payload);
+        bytes += payload;
+    }
+    return bytes;
+}
+
+static size_t packed_serialize(const roaring_bitmap_t *r, char *buf,
+                               bool compress) {
+    const roaring_array_t *ra = &r->high_low_container;
+    uint8_t *out = (uint8_t *)buf;
+    const uint32_t cookie = PACKED_SERIAL_COOKIE;
+    const uint32_t size = (uint32_t)ra->size;
+    memcpy(out, &cookie, sizeof(cookie));
+    memcpy(out + sizeof(cookie), &size, sizeof(size));
+    uint8_t *keys = out + 2 * sizeof(uint32_t);
+    uint8_t *cards = keys + size * sizeof(uint16_t);
+    uint8_t *kinds = cards + size * sizeof(uint16_t);
+    uint8_t *payload = kinds + size;
+    for (int32_t i = 0; i < ra->size; i++) {
+        uint16_t card = (uint16_t)(container_get_cardinality(
+                ra->containers[i], ra->typecodes[i]) - 1);
+        memcpy(keys + i * sizeof(uint16_t), &ra->keys[i], sizeof(uint16_t));
+        memcpy(cards + i * sizeof(uint16_t), &card, sizeof(card));
+        size_t ignored;
+        kinds[i] = packed_kind(ra->containers[i], ra->typecodes[i], compress,
+                               &ignored);
+        payload += packed_write_payload(ra->containers[i], ra->typecodes[i],
+                                        kinds[i], payload);
+    }
+    return (size_t)(payload - out);
+}
+
+size_t roaring_bitmap_packed_size_in_bytes(const roaring_bitmap_t *r) {
+    return packed_size_in_bytes(r, false);
+}
+
+size_t roaring_bitmap_packed_serialize(const roaring_bitmap_t *r, char *buf) {
+    return packed_serialize(r, buf, false);
+}
+
+size_t roaring_bitmap_compressed_size_in_bytes(const roaring_bitmap_t *r) {
+    return packed_size_in_bytes(r, true);
+}
+
+size_t roaring_bitmap_compressed_serialize(const roaring_bitmap_t *r,
+                                           char *buf) {
+    return packed_serialize(r, buf, true);
+}
+
+bool roaring_bitmap_is_packed_serialization(const char *buf, size_t maxbytes) {
+    uint32_t cookie;
+    if (maxbytes < sizeof(cookie)) {
+        return false;
+    }
+    memcpy(&cookie, buf, sizeof(cookie));
+    return cookie == PACKED_SERIAL_COOKIE;
+}
+
+/* Decode a block of n values following prev, coded as kind (delta bitpacked
+ * or varint). Returns the bytes consumed, or 0 on invalid input. */
+static size_t values_read_block(const uint8_t *in, size_t maxbytes,
+                                uint8_t kind, int32_t n, int32_t prev,
+                                uint16_t *out) {
+    if (kind == PACKED_KIND_DELTA) {
+        return packed_decode_block(in, maxbytes, n, prev, out);
+    }
+    size_t bytes = 0;
+    for (int32_t i = 0; i < n; i++) {
+        uint32_t gap;
+        size_t used = varint_read(in + bytes, maxbytes - bytes, &gap);
+        if (used == 0 || (uint32_t)(prev + 1) + gap > UINT16_MAX) {
+            return 0;
+        }
+        bytes += used;
+        prev = (int32_t)((uint32_t)(prev + 1) + gap);
+        out[i] = (uint16_t)prev;
+    }
+    return bytes;
+}
+
+/* Container of card values decoded from a PACKED_KIND_DELTA or
+ * PACKED_KIND_VARINT payload, or NULL; *bytes receives the payload size. */
+static container_t *packed_read_values(const uint8_t *in, size_t maxbytes,
+                                       uint8_t kind, int32_t card,
+                                       uint8_t *type, size_t *bytes) {
+    array_container_t *ac = NULL;
+    bitset_container_t *bc = NULL;
+    if (card <= DEFAULT_MAX_SIZE) {
+        ac = array_container_create_given_capacity(card);
+    } else {
+        bc = bitset_container_create();
+    }
+    if (ac == NULL && bc == NULL) {
+        return NULL;
+    }
+    uint16_t block[PACKED_BLOCK_SIZE];
+    size_t used = 0;
+    int32_t prev = -1;
+    for (int32_t i = 0; i < card; i += PACKED_BLOCK_SIZE) {
+        int32_t n = card - i < PACKED_BLOCK_SIZE ? card - i : PACKED_BLOCK_SIZE;
+        uint16_t *out = ac != NULL ? ac->array + i : block;
+        size_t b = values_read_block(in + used, maxbytes - used, kind, n, prev,
+                                     out);
+        if (b == 0) {
+            if (ac != NULL) {
+                array_container_free(ac);
+            } else {
+                bitset_container_free(bc);
+            }
+            return NULL;
+        }
+        used += b;
+        if (bc != NULL) {
+            bitset_set_list(bc->words, block, n);
+        }
+        prev = out[n - 1];
+    }
+    *bytes = used;
+    if (ac != NULL) {
+        ac->cardinality = card;
+        *type = ARRAY_CONTAINER_TYPE;
+        return ac;
+    }
+    bc->cardinality = card;
+    *type = BITSET_CONTAINER_TYPE;
+    return bc;
+}
+
+/* Bitset container decoded from a PACKED_KIND_WORDS payload, or NULL; *bytes
+ * receives the payload size. */
+static container_t *packed_read_words(const uint8_t *in, size_t maxbytes,
+                                      int32_t card, uint8_t *type,
+                                      size_t *bytes) {
+    bitset_container_t *bc = bitset_container_create();
+    if (bc == NULL) {
+        return NULL;
+    }
+    size_t used = 0;
+    uint32_t i = 0;
+    while (i < BITSET_CONTAINER_SIZE_IN_WORDS) {
+        uint32_t counts[3];
+        for (int k = 0; k < 3; k++) {
+            size_t b = varint_read(in + used, maxbytes - used, &counts[k]);
+            if (b == 0 || counts[k] > BITSET_CONTAINER_SIZE_IN_WORDS - i) {
+                bitset_container_free(bc);
+                return NULL;
+            }
+            used += b;
+            i += counts[k];
+        }
+        if (counts[0] + counts[1] + counts[2] == 0 ||
+            counts[2] * sizeof(uint64_t) > maxbytes - used) {
+            bitset_container_free(bc);
+            return NULL;
+        }
+        // empty words are zero already
+        uint64_t *words = bc->words + i - counts[2] - counts[1];
+        memset(words, 0xFF, counts[1] * sizeof(uint64_t));
+        memcpy(words + counts[1], in + used, counts[2] * sizeof(uint64_t));
+        used += counts[2] * sizeof(uint64_t);
+    }
+    bc->cardinality = card;
+    *bytes = used;
+    *type = BITSET_CONTAINER_TYPE;
+    return bc;
+}
+
+/* Container read from the payload of the given kind, or NULL; *bytes
+ * receives the payload size. */
+static container_t *packed_read_container(const uint8_t *in, size_t maxbytes,
+                                          uint8_t kind, int32_t card,
+                                          uint8_t *type, size_t *bytes) {
+    switch (kind) {
+        case PACKED_KIND_DELTA:
+        case PACKED_KIND_VARINT:
+            return packed_read_values(in, maxbytes, kind, card, type, bytes);
+        case PACKED_KIND_WORDS:
+            return packed_read_words(in, maxbytes, card, type, bytes);
+        case PACKED_KIND_ARRAY: {
+            *bytes = card * sizeof(uint16_t);
+            if (*bytes > maxbytes) {
+                return NULL;
+            }
+            if (card > DEFAULT_MAX_SIZE) {
+                bitset_container_t *bc = bitset_container_create();
+                if (bc == NULL) {
+                    return NULL;
+                }
+                for (int32_t i = 0; i < card; i++) {
+                    uint16_t v;
+                    memcpy(&v, in + i * sizeof(uint16_t), sizeof(v));
+                    bitset_container_set(bc, v);
+                }
+                *type = BITSET_CONTAINER_TYPE;
+                return bc;
+            }
+            array_container_t *ac = array_container_create_given_capacity(card);
+            if (ac == NULL) {
+                return NULL;
+            }
+            memcpy(ac->array, in, *bytes);
+            ac->cardinality = card;
+            *type = ARRAY_CONTAINER_TYPE;
+            return ac;
+        }
+        case PACKED_KIND_BITSET: {
+            *bytes = BITSET_BYTES;
+            if (*bytes > maxbytes) {
+                return NULL;
+            }
+            bitset_container_t *bc = bitset_container_create();
+            if (bc == NULL) {
+                return NULL;
+            }
+            memcpy(bc->words, in, *bytes);
+            bc->cardinality = card;
+            *type = BITSET_CONTAINER_TYPE;
+            return bc;
+        }
+        case PACKED_KIND_RUN: {
+            uint16_t n_runs;
+            if (maxbytes < sizeof(n_runs)) {
+                return NULL;
+            }
+            memcpy(&n_runs, in, sizeof(n_runs));
+            *bytes = sizeof(n_runs) + n_runs * sizeof(rle16_t);
+            if (*bytes > maxbytes) {
+                return NULL;
+            }
+            run_container_t *rc = run_container_create_given_capacity(n_runs);
+            if (rc == NULL) {
+                return NULL;
+            }
+            memcpy(rc->runs, in + sizeof(n_runs), n_runs * sizeof(rle16_t));
+            rc->n_runs = n_runs;
+            *type = RUN_CONTAINER_TYPE;
+            return rc;
+        }
+        default:
+            return NULL;
+    }
+}
+
+roaring_bitmap_t *roaring_bitmap_packed_deserialize_safe(const char *buf,
+                                                         size_t maxbytes) {
+    if (!roaring_bitmap_is_packed_serialization(buf, maxbytes) ||
+        maxbytes < 2 * sizeof(uint32_t)) {
+        return NULL;
+    }
+    const uint8_t *in = (const uint8_t *)buf;
+    uint32_t size;
+    memcpy(&size, in + sizeof(uint32_t), sizeof(size));
+    if (size > (1 << 16) || PACKED_HEADER_BYTES(size) > maxbytes) {
+        return NULL;
+    }
+    const uint8_t *keys = in + 2 * sizeof(uint32_t);
+    const uint8_t *cards = keys + size * sizeof(uint16_t);
+    const uint8_t *kinds = cards + size * sizeof(uint16_t);
+    size_t used = PACKED_HEADER_BYTES(size);
+    roaring_bitmap_t *r = roaring_bitmap_create_with_capacity(size);
+    if (r == NULL) {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < size; i++) {
+        uint16_t key, card;
+        memcpy(&key, keys + i * sizeof(uint16_t), sizeof(key));
+        memcpy(&card, cards + i * sizeof(uint16_t), sizeof(card));
+        if (i > 0 && key <= r->high_low_container.keys[i - 1]) {
+            roaring_bitmap_free(r);
+            return NULL;
+        }
+        uint8_t type;
+        size_t bytes;
+        container_t *c = packed_read_container(in + used, maxbytes - used,
+                                               kinds[i], (int32_t)card + 1,
+                                               &type, &bytes);
+        if (c == NULL) {
+            roaring_bitmap_free(r);
+            return NULL;
+        }
+        ra_append(&r->high_low_container, key, c, type);
+        used += bytes;
+    }
+    return r;
+}
+
+#ifdef __cplusplus
+} } }  // extern "C" { namespace roaring { namespace api {
+#endif
@@ -0,0 +1,197 @@
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "roaring.h"
+#include "roaring_array.h"
+
+#include "bluebird/bits/roaring/containers/containers.h"
+
+#ifdef __cplusplus
+extern "C" { namespace roaring { namespace internal {
+#endif
+
+roaring_perf_parameters_t roaring_perf_parameters = {
+    ARRAY_LAZY_LOWERBOUND,
+    LAZY_OR_BITSET_CONVERSION,
+    LAZY_OR_BITSET_CONVERSION_TO_FULL,
+    OR_BITSET_CONVERSION_TO_FULL,
+    MEMBERSHIP_MAX_RUNS,
+    UNION_MAX_RUNS,
+    false
+};
+
+croaring_counter_t roaring_profile_counters[ROARING_PROFILE_COUNTERS];
+
+#ifdef CROARING_STATS
+croaring_counter_t
+    roaring_stats_ops[ROARING_STATS_OPS][ROARING_STATS_CONTAINER_TYPES]
+                     [ROARING_STATS_CONTAINER_TYPES];
+croaring_counter_t
+    roaring_stats_conversions[ROARING_STATS_CONTAINER_TYPES]
+                             [ROARING_STATS_CONTAINER_TYPES];
+croaring_counter_t roaring_stats_cow_copies;
+croaring_counter_t roaring_stats_allocations;
+croaring_counter_t roaring_stats_bytes_allocated;
+#endif
+
+#ifdef __cplusplus
+} } }  // extern "C" { namespace roaring { namespace internal {
+#endif
+
+#ifdef __cplusplus
+using namespace ::roaring::internal;
+
+extern "C" { namespace roaring { namespace api {
+#endif
+
+void roaring_get_perf_parameters(roaring_perf_parameters_t *params) {
+    *params = roaring_perf_parameters;
+}
+
+void roaring_set_perf_parameters(const roaring_perf_parameters_t *params) {
+    roaring_perf_parameters = *params;
+    // larger lazy arrays would outlive the repair as oversized arrays
+    if (roaring_perf_parameters.array_lazy_lowerbound > DEFAULT_MAX_SIZE) {
+        roaring_perf_parameters.array_lazy_lowerbound = DEFAULT_MAX_SIZE;
+    }
+}
+
+void roaring_profile_get(roaring_profile_t *profile) {
+    croaring_counter_t *counters = roaring_profile_counters;
+    profile->n_contains =
+        croaring_counter_get(&counters[ROARING_PROFILE_CONTAINS]);
+    profile->n_updates = croaring_counter_get(&counters[ROARING_PROFILE_UPDATES]);
+    profile->n_unions = croaring_counter_get(&counters[ROARING_PROFILE_UNIONS]);
+    profile->n_intersections =
+        croaring_counter_get(&counters[ROARING_PROFILE_INTERSECTIONS]);
+    profile->n_lazy_array_to_bitset =
+        croaring_counter_get(&counters[ROARING_PROFILE_LAZY_ARRAY_TO_BITSET]);
+    profile->n_lazy_bitset_to_array =
+        croaring_counter_get(&counters[ROARING_PROFILE_LAZY_BITSET_TO_ARRAY]);
+}
+
+void roaring_profile_reset(void) {
+    for (int i = 0; i < ROARING_PROFILE_COUNTERS; i++) {
+        croaring_counter_reset(&roaring_profile_counters[i]);
+    }
+}
+
+roaring_access_pattern_t roaring_profile_suggest(
+    const roaring_profile_t *profile, roaring_perf_parameters_t *params) {
+    // Lazy unions turn arrays into bitsets early and repair them at the end.
+    // When most of these bitsets are turned back into arrays, the eager
+    // conversion was wasted: raise the bound. When almost none are, lower it.
+    const uint64_t converted = profile->n_lazy_array_to_bitset;
+    const uint64_t reverted = profile->n_lazy_bitset_to_array;
+    if (converted >= 64) {
+        if (2 * reverted > converted) {
+            params->array_lazy_lowerbound *= 2;
+            if (params->array_lazy_lowerbound > DEFAULT_MAX_SIZE) {
+                params->array_lazy_lowerbound = DEFAULT_MAX_SIZE;
+            }
+        } else if (10 * reverted < converted &&
+                   params->array_lazy_lowerbound >= 256) {
+            params->array_lazy_lowerbound /= 2;
+        }
+    }
+    const uint64_t setops = profile->n_unions + profile->n_intersections;
+    if (profile->n_contains > 4 * (setops + profile->n_updates)) {
+        return ROARING_ACCESS_MEMBERSHIP;
+    }
+    if (setops > 4 * (profile->n_contains + profile->n_updates)) {
+        return ROARING_ACCESS_UNION;
+    }
+    return ROARING_ACCESS_SIZE;
+}
+
+bool roaring_op_stats_enabled(void) {
+#ifdef CROARING_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void roaring_op_stats_get(roaring_op_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+#ifdef CROARING_STATS
+    for (int op = 0; op < ROARING_STATS_OPS; op++) {
+        for (int t1 = 0; t1 < ROARING_STATS_CONTAINER_TYPES; t1++) {
+            for (int t2 = 0; t2 < ROARING_STATS_CONTAINER_TYPES; t2++) {
+                stats->ops[op][t1][t2] =
+                    croaring_counter_get(&roaring_stats_ops[op][t1][t2]);
+            }
+        }
+    }
+    for (int t1 = 0; t1 < ROARING_STATS_CONTAINER_TYPES; t1++) {
+        for (int t2 = 0; t2 < ROARING_STATS_CONTAINER_TYPES; t2++) {
+            stats->conversions[t1][t2] =
+                croaring_counter_get(&roaring_stats_conversions[t1][t2]);
+        }
+    }
+    stats->cow_copies = croaring_counter_get(&roaring_stats_cow_copies);
+    stats->allocations = croaring_counter_get(&roaring_stats_allocations);
+    stats->bytes_allocated =
+        croaring_counter_get(&roaring_stats_bytes_allocated);
+#endif
+}
+
+void roaring_op_stats_reset(void) {
+#ifdef CROARING_STATS
+    for (int op = 0; op < ROARING_STATS_OPS; op++) {
+        for (int t1 = 0; t1 < ROARING_STATS_CONTAINER_TYPES; t1++) {
+            for (int t2 = 0; t2 < ROARING_STATS_CONTAINER_TYPES; t2++) {
+                croaring_counter_reset(&roaring_stats_ops[op][t1][t2]);
+            }
+        }
+    }
+    for (int t1 = 0; t1 < ROARING_STATS_CONTAINER_TYPES; t1++) {
+        for (int t2 = 0; t2 < ROARING_STATS_CONTAINER_TYPES; t2++) {
+            croaring_counter_reset(&roaring_stats_conversions[t1][t2]);
+        }
+    }
+    croaring_counter_reset(&roaring_stats_cow_copies);
+    croaring_counter_reset(&roaring_stats_allocations);
+    croaring_counter_reset(&roaring_stats_bytes_allocated);
+#endif
+}
+
+bool roaring_bitmap_run_optimize_for(roaring_bitmap_t *r,
+                                     roaring_access_pattern_t pattern) {
+    bool answer = roaring_bitmap_run_optimize(r);
+    if (pattern == ROARING_ACCESS_SIZE || !answer) {
+        return answer;
+    }
+    // Run containers are only kept where they are cheap to query: sparse ones
+    // would be larger arrays, and dense ones with few runs beat bitsets on
+    // every operation. Dense ones with many runs are searched run by run.
+    const uint32_t max_runs =
+        pattern == ROARING_ACCESS_MEMBERSHIP
+            ? roaring_perf_parameters.membership_max_runs
+            : roaring_perf_parameters.union_max_runs;
+    roaring_array_t *ra = &r->high_low_container;
+    answer = false;
+    for (int i = 0; i < ra->size; i++) {
+        uint8_t type;
+        // roaring_bitmap_run_optimize() unshared every container
+        container_t *c = ra_get_container_at_index(ra, i, &type);
+        if (type != RUN_CONTAINER_TYPE) {
+            continue;
+        }
+        run_container_t *rc = CAST_run(c);
+        if ((uint32_t)rc->n_runs > max_runs &&
+            run_container_cardinality(rc) > DEFAULT_MAX_SIZE) {
+            bitset_container_t *bc = bitset_container_from_run(rc);
+            run_container_free(rc);
+            ra_set_container_at_index(ra, i, bc, BITSET_CONTAINER_TYPE);
+        } else {
+            answer = true;
+        }
+    }
+    return answer;
+}
+
+#ifdef __cplusplus
+} } }  // extern "C" { namespace roaring { namespace api {
+#endif
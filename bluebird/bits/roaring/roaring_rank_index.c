@@ -0,0 +1,221 @@
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "roaring.h"
+#include "roaring_array.h"
+
+#include "bluebird/bits/roaring/containers/containers.h"
+
+#ifdef __cplusplus
+using namespace ::roaring::internal;
+
+extern "C" { namespace roaring { namespace api {
+#endif
+
+// A bitset container is summarized by the number of values preceding each of
+// its blocks of 8 words (512 bits); rank and select then touch at most one
+// block of words.
+#define RANK_INDEX_WORDS_PER_BLOCK 8
+#define RANK_INDEX_BLOCKS \
+    (BITSET_CONTAINER_SIZE_IN_WORDS / RANK_INDEX_WORDS_PER_BLOCK)
+#define RANK_INDEX_NO_BLOCKS UINT32_MAX
+
+bool roaring_rank_index_init(roaring_rank_index_t *index,
+                             const roaring_bitmap_t *r) {
+    const roaring_array_t *ra = &r->high_low_container;
+    memset(index, 0, sizeof(*index));
+    index->size = ra->size;
+    index->cumulative =
+        (uint64_t *)roaring_malloc((ra->size + 1) * sizeof(uint64_t));
+    index->block_start =
+        (uint32_t *)roaring_malloc((ra->size + 1) * sizeof(uint32_t));
+    if (index->cumulative == NULL || index->block_start == NULL) {
+        roaring_rank_index_clear(index);
+        return false;
+    }
+    uint32_t bitsets = 0;
+    uint64_t total = 0;
+    for (int32_t i = 0; i < ra->size; i++) {
+        uint8_t type = ra->typecodes[i];
+        const container_t *c = container_unwrap_shared(ra->containers[i], &type);
+        index->cumulative[i] = total;
+        total += container_get_cardinality(c, type);
+        if (type == BITSET_CONTAINER_TYPE) {
+            index->block_start[i] = bitsets * RANK_INDEX_BLOCKS;
+            bitsets++;
+        } else {
+            index->block_start[i] = RANK_INDEX_NO_BLOCKS;
+        }
+    }
+    index->cumulative[ra->size] = total;
+    if (bitsets == 0) {
+        return true;
+    }
+    index->blocks = (uint16_t *)roaring_malloc(
+        (size_t)bitsets * RANK_INDEX_BLOCKS * sizeof(uint16_t));
+    if (index->blocks == NULL) {
+        roaring_rank_index_clear(index);
+        return false;
+    }
+    for (int32_t i = 0; i < ra->size; i++) {
+        if (index->block_start[i] == RANK_INDEX_NO_BLOCKS) {
+            continue;
+        }
+        uint8_t type = ra->typecodes[i];
+        const bitset_container_t *b = const_CAST_bitset(
+            container_unwrap_shared(ra->containers[i], &type));
+        uint16_t *blocks = index->blocks + index->block_start[i];
+        uint32_t sum = 0;
+        for (int block = 0; block < RANK_INDEX_BLOCKS; block++) {
+            blocks[block] = (uint16_t)sum;
+            const uint64_t *words =
+                b->words + block * RANK_INDEX_WORDS_PER_BLOCK;
+            for (int w = 0; w < RANK_INDEX_WORDS_PER_BLOCK; w++) {
+                sum += roaring_hamming(words[w]);
+            }
+        }
+    }
+    return true;
+}
+
+void roaring_rank_index_clear(roaring_rank_index_t *index) {
+    roaring_free(index->cumulative);
+    roaring_free(index->block_start);
+    roaring_free(index->blocks);
+    memset(index, 0, sizeof(*index));
+}
+
+/* Number of values smaller or equal to x in a bitset with block counts. */
+static inline uint32_t bitset_rank_blocks(const bitset_container_t *b,
+                                          const uint16_t *blocks, uint16_t x) {
+    const uint32_t word = x / 64;
+    const uint32_t first = (word / RANK_INDEX_WORDS_PER_BLOCK) *
+                           RANK_INDEX_WORDS_PER_BLOCK;
+    uint32_t sum = blocks[word / RANK_INDEX_WORDS_PER_BLOCK];
+    for (uint32_t i = first; i < word; i++) {
+        sum += roaring_hamming(b->words[i]);
+    }
+    uint64_t lastpos = UINT64_C(1) << (x % 64);
+    sum += roaring_hamming(b->words[word] & (lastpos + lastpos - 1));
+    return sum;
+}
+
+/* Value of rank `rank` (0-based, below the cardinality) in a bitset with
+ * block counts. */
+static inline uint16_t bitset_select_blocks(const bitset_container_t *b,
+                                            const uint16_t *blocks,
+                                            uint32_t rank) {
+    // last block preceded by at most `rank` values
+    int32_t low = 0, high = RANK_INDEX_BLOCKS - 1;
+    while (low < high) {
+        int32_t middle = (low + high + 1) / 2;
+        if (blocks[middle] <= rank) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    rank -= blocks[low];
+    uint32_t i = (uint32_t)low * RANK_INDEX_WORDS_PER_BLOCK;
+    uint64_t w = b->words[i];
+    for (uint32_t count = roaring_hamming(w); count <= rank;
+         count = roaring_hamming(w)) {
+        rank -= count;
+        w = b->words[++i];
+    }
+    for (; rank > 0; rank--) {
+        w &= w - 1;  // clear the lowest set bit
+    }
+    return (uint16_t)(i * 64 + roaring_trailing_zeroes(w));
+}
+
+uint64_t roaring_bitmap_rank_indexed(const roaring_bitmap_t *r,
+                                     const roaring_rank_index_t *index,
+                                     uint32_t x) {
+    const roaring_array_t *ra = &r->high_low_container;
+    assert(index->size == ra->size);
+    int32_t i = ra_get_index(ra, (uint16_t)(x >> 16));
+    if (i < 0) {
+        return index->cumulative[-i - 1];
+    }
+    if (index->block_start[i] != RANK_INDEX_NO_BLOCKS) {
+        uint8_t type = ra->typecodes[i];
+        const bitset_container_t *b = const_CAST_bitset(
+            container_unwrap_shared(ra->containers[i], &type));
+        return index->cumulative[i] +
+               bitset_rank_blocks(b, index->blocks + index->block_start[i],
+                                  (uint16_t)x);
+    }
+    return index->cumulative[i] +
+           container_rank(ra->containers[i], ra->typecodes[i], (uint16_t)x);
+}
+
+int64_t roaring_bitmap_get_index_indexed(const roaring_bitmap_t *r,
+                                         const roaring_rank_index_t *index,
+                                         uint32_t x) {
+    const roaring_array_t *ra = &r->high_low_container;
+    assert(index->size == ra->size);
+    int32_t i = ra_get_index(ra, (uint16_t)(x >> 16));
+    if (i < 0) {
+        return -1;
+    }
+    if (index->block_start[i] != RANK_INDEX_NO_BLOCKS) {
+        uint8_t type = ra->typecodes[i];
+        const bitset_container_t *b = const_CAST_bitset(
+            container_unwrap_shared(ra->containers[i], &type));
+        if (!bitset_container_get(b, (uint16_t)x)) {
+            return -1;
+        }
+        return (int64_t)index->cumulative[i] +
+               bitset_rank_blocks(b, index->blocks + index->block_start[i],
+                                  (uint16_t)x) - 1;
+    }
+    int low_idx = container_get_index(ra->containers[i], ra->typecodes[i],
+                                      (uint16_t)x);
+    if (low_idx < 0) {
+        return -1;
+    }
+    return (int64_t)index->cumulative[i] + low_idx;
+}
+
+bool roaring_bitmap_select_indexed(const roaring_bitmap_t *r,
+                                   const roaring_rank_index_t *index,
+                                   uint32_t rank, uint32_t *element) {
+    const roaring_array_t *ra = &r->high_low_container;
+    assert(index->size == ra->size);
+    if (rank >= index->cumulative[index->size]) {
+        return false;
+    }
+    // last container preceded by at most `rank` values
+    int32_t low = 0, high = index->size - 1;
+    while (low < high) {
+        int32_t middle = (low + high + 1) / 2;
+        if (index->cumulative[middle] <= rank) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    const uint32_t key = (uint32_t)ra->keys[low] << 16;
+    uint32_t local = rank - (uint32_t)index->cumulative[low];
+    if (index->block_start[low] != RANK_INDEX_NO_BLOCKS) {
+        uint8_t type = ra->typecodes[low];
+        const bitset_container_t *b = const_CAST_bitset(
+            container_unwrap_shared(ra->containers[low], &type));
+        *element = key | bitset_select_blocks(
+            b, index->blocks + index->block_start[low], local);
+        return true;
+    }
+    uint32_t start_rank = 0;
+    if (!container_select(ra->containers[low], ra->typecodes[low], &start_rank,
+                          local, element)) {
+        return false;
+    }
+    *element |= key;
+    return true;
+}
+
+#ifdef __cplusplus
+} } }  // extern "C" { namespace roaring { namespace api {
+#endif
@@ -97,6 +97,93 @@ typedef struct roaring_statistics_s {
     // and n_values_arrays, n_values_rle, n_values_bitmap
 } roaring_statistics_t;
 
+/**
+*  (For advanced users.)
+* The roaring_perf_parameters_t hold the container conversion thresholds that
+* can be tuned at runtime, see roaring_set_perf_parameters(). They apply to
+* every bitmap of the process. The default values are the compile-time ones.
+*/
+typedef struct roaring_perf_parameters_s {
+    /* during lazy unions, array containers whose combined cardinality
+       exceeds this bound are turned into bitsets, at most 4096 */
+    uint32_t array_lazy_lowerbound;
+    /* whether roaring_bitmap_or_many() and friends convert to bitsets
+       eagerly */
+    bool lazy_or_bitset_conversion;
+    /* whether lazy unions of bitsets check for a full container */
+    bool lazy_or_bitset_conversion_to_full;
+    /* whether in-place unions of bitsets check for a full container */
+    bool or_bitset_conversion_to_full;
+    /* roaring_bitmap_run_optimize_for() turns dense run containers with more
+       runs than these into bitsets, for each access pattern */
+    uint32_t membership_max_runs;
+    uint32_t union_max_runs;
+    /* whether to count operations, see roaring_profile_get() */
+    bool profile;
+} roaring_perf_parameters_t;
+
+/**
+*  (For advanced users.)
+* What a bitmap is mostly used for, which decides the container types
+* roaring_bitmap_run_optimize_for() picks.
+*/
+typedef enum roaring_access_pattern_e {
+    ROARING_ACCESS_SIZE = 0,   /* smallest containers */
+    ROARING_ACCESS_MEMBERSHIP, /* mostly contains() and rank queries */
+    ROARING_ACCESS_UNION       /* mostly unions and intersections */
+} roaring_access_pattern_t;
+
+/**
+*  (For advanced users.)
+* Operation and conversion counts gathered while profiling is on.
+*/
+typedef struct roaring_profile_s {
+    uint64_t n_contains;      /* membership and rank queries */
+    uint64_t n_updates;       /* values added or removed */
+    uint64_t n_unions;        /* unions, including xor */
+    uint64_t n_intersections; /* intersections, including andnot */
+    uint64_t n_lazy_array_to_bitset; /* containers made bitsets lazily */
+    uint64_t n_lazy_bitset_to_array; /* bitsets turned back into arrays */
+} roaring_profile_t;
+
+/**
+*  (For advanced users.)
+* Operations counted by roaring_op_stats_t, and the container types they are
+* broken down by (the internal typecodes minus one).
+*/
+typedef enum roaring_stats_op_e {
+    ROARING_STATS_AND = 0, /* intersections, including cardinality only */
+    ROARING_STATS_OR,      /* unions, lazy or not */
+    ROARING_STATS_XOR,
+    ROARING_STATS_ANDNOT,
+    ROARING_STATS_OPS
+} roaring_stats_op_t;
+
+typedef enum roaring_stats_container_e {
+    ROARING_STATS_BITSET = 0,
+    ROARING_STATS_ARRAY,
+    ROARING_STATS_RUN,
+    ROARING_STATS_CONTAINER_TYPES
+} roaring_stats_container_t;
+
+/**
+*  (For advanced users.)
+* Process-wide counts of the container-level work, see roaring_op_stats_get().
+* All zero unless the library is built with CROARING_STATS defined.
+*/
+typedef struct roaring_op_stats_s {
+    /* container operations by kind and by pair of container types */
+    uint64_t ops[ROARING_STATS_OPS][ROARING_STATS_CONTAINER_TYPES]
+                [ROARING_STATS_CONTAINER_TYPES];
+    /* containers converted, by type before and after */
+    uint64_t conversions[ROARING_STATS_CONTAINER_TYPES]
+                        [ROARING_STATS_CONTAINER_TYPES];
+    uint64_t cow_copies;      /* shared containers copied before a write */
+    uint64_t allocations;     /* calls to the roaring allocator */
+    uint64_t bytes_allocated; /* bytes requested from it, reallocations
+                                 included */
+} roaring_op_stats_t;
+
 #ifdef __cplusplus
 } } }  // extern "C" { namespace roaring { namespace api {
 #endif